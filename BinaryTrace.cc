@@ -0,0 +1,160 @@
+#include "BinaryTrace.hh"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+namespace BinaryTrace {
+namespace {
+
+/* FNV-1a over the header, with the checksum field taken as zero */
+uint64_t header_checksum(const Header& header) {
+  Header copy   = header;
+  copy.checksum = 0;
+
+  const auto bytes = reinterpret_cast<const unsigned char*>(&copy);
+  uint64_t hash { 0xcbf29ce484222325 };
+  for (size_t i = 0; i < sizeof(Header); i++) hash = (hash ^ bytes[i]) * 0x100000001b3;
+  return hash;
+}
+}  // namespace
+
+bool has_magic(const char* data, size_t size) {
+  return size >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+Header make_header(const TraceSummary& summary) {
+  Header header {};
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version     = VERSION;
+  header.header_size = sizeof(Header);
+  header.record_size = RECORD_SIZE;
+  header.field_count = 6;
+  std::copy(std::begin(LAYOUT), std::end(LAYOUT), header.layout);
+  header.summary  = summary;
+  header.checksum = header_checksum(header);
+  return header;
+}
+
+void check_header(const Header& header) {
+  if (!has_magic(header.magic, sizeof(header.magic)))
+    throw std::invalid_argument("Not a binary trace file");
+  if (header.version != VERSION)
+    throw std::invalid_argument("Unsupported binary trace version: " +
+                                std::to_string(header.version));
+  if (header.checksum != header_checksum(header))
+    throw std::invalid_argument("Binary trace header is corrupt");
+  if (header.header_size < sizeof(Header) || header.record_size != RECORD_SIZE ||
+      header.field_count != 6 ||
+      !std::equal(std::begin(LAYOUT), std::end(LAYOUT), header.layout))
+    throw std::invalid_argument("Unsupported binary trace record layout");
+}
+
+std::optional<TraceSummary> read_summary(const std::string& fname) {
+  std::ifstream f { fname, std::ios::binary };
+  if (!f.is_open()) throw std::invalid_argument("Cannot open trace file: " + fname);
+
+  Header header;
+  if (!f.read(reinterpret_cast<char*>(&header), sizeof(Header)) ||
+      !has_magic(header.magic, sizeof(header.magic)))
+    return std::nullopt;
+
+  check_header(header);
+  return header.summary;
+}
+
+Writer::Writer(const std::string& fname, size_t buffer_records)
+    : file(fname, std::ios::binary),
+      buffer_records(buffer_records),
+      buffer(buffer_records * RECORD_SIZE),
+      uncaught_exceptions(std::uncaught_exceptions()) {
+  if (!file.is_open()) throw std::invalid_argument("Cannot open output file: " + fname);
+  if (buffer_records == 0) throw std::invalid_argument("Buffer size must not be 0");
+
+  // The header is rewritten with the summary once the trace is complete
+  const Header header {};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+}
+
+Writer::~Writer() {
+  if (std::uncaught_exceptions() > uncaught_exceptions) return;
+  try {
+    finish();
+  } catch (...) {
+  }
+}
+
+void Writer::flush_buffer_() {
+  file.write(buffer.data(), buffered * RECORD_SIZE);
+  buffered = 0;
+}
+
+void Writer::finish() {
+  if (finished) return;
+  finished = true;
+
+  flush_buffer_();
+  const Header header = make_header(summariser.get());
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  file.close();
+
+  if (file.fail()) throw std::runtime_error("Failed to write binary trace");
+}
+}  // namespace BinaryTrace
+
+// ------
+
+MappedBinaryTrace::MappedBinaryTrace(const std::string& fname) : file(fname) {
+  if (BinaryTrace::has_magic(file.data(), file.size())) {
+    BinaryTrace::Header header;
+    if (file.size() < sizeof(BinaryTrace::Header))
+      throw std::invalid_argument("Binary trace file is too short: " + fname);
+    std::memcpy(&header, file.data(), sizeof(BinaryTrace::Header));
+    BinaryTrace::check_header(header);
+
+    length         = header.summary.record_count;
+    records_offset = header.header_size;
+    summary        = header.summary;
+  } else {
+    if (file.size() < BinaryTrace::LEGACY_HEADER_SIZE)
+      throw std::invalid_argument("Binary trace file is too short: " + fname);
+
+    std::memcpy(&length, file.data(), sizeof(size_t));
+    records_offset = BinaryTrace::LEGACY_HEADER_SIZE;
+  }
+
+  if (file.size() < records_offset + length * BinaryTrace::RECORD_SIZE)
+    throw std::invalid_argument("Binary trace file is truncated: " + fname);
+
+  // Records are almost always read front to back, so ask for aggressive readahead
+  file.advise(MADV_SEQUENTIAL);
+}
+
+const char* MappedBinaryTrace::records() const { return file.data() + records_offset; }
+
+size_t MappedBinaryTrace::size() const { return length; }
+
+const std::optional<TraceSummary>& MappedBinaryTrace::getSummary() const {
+  return summary;
+}
+
+void MappedBinaryTrace::willneed(size_t first, size_t count) const {
+  file.advise(MADV_WILLNEED, records_offset + first * BinaryTrace::RECORD_SIZE,
+              count * BinaryTrace::RECORD_SIZE);
+}
+
+void MappedBinaryTrace::dontneed(size_t first, size_t count) const {
+  file.advise(MADV_DONTNEED, records_offset + first * BinaryTrace::RECORD_SIZE,
+              count * BinaryTrace::RECORD_SIZE);
+}
+
+MappedBinaryTrace::const_iterator MappedBinaryTrace::begin() const {
+  return const_iterator { records() };
+}
+
+MappedBinaryTrace::const_iterator MappedBinaryTrace::end() const {
+  return const_iterator { records() + length * BinaryTrace::RECORD_SIZE };
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hh"
+#include "MemoryTrace.hh"
+
+/* The raw binary trace format (v4) written by `MemoryTrace::write_binary`: a `Header`,
+ * followed by packed records of tid, size, bundle_kind, is_write, address, pc.
+ *
+ * The header describes the record layout and carries a summary of the trace, so that
+ * statistics are available without reading the records. Its checksum covers the header
+ * itself, with the checksum field zeroed.
+ *
+ * Older (v1) traces have no header, and start with a `size_t` record count instead. They
+ * are still read, but have no summary */
+namespace BinaryTrace {
+
+constexpr char MAGIC[8]    = { 'S', 'C', 'S', 'B', 'T', 'R', 'C', 'E' };
+constexpr uint32_t VERSION = 4;
+
+constexpr size_t RECORD_SIZE = 3 * sizeof(int) + sizeof(bool) + 2 * sizeof(uint64_t);
+
+/* The size of the record count that v1 traces start with */
+constexpr size_t LEGACY_HEADER_SIZE = sizeof(size_t);
+
+/* The size in bytes of each record field, in order */
+constexpr uint8_t LAYOUT[8] = { sizeof(int),  sizeof(int),      sizeof(int),
+                                sizeof(bool), sizeof(uint64_t), sizeof(uint64_t) };
+
+/* The number of records buffered by `Writer` before they are written out */
+constexpr size_t WRITE_BUFFER_RECORDS = 1 << 16;
+
+/* Laid out with no padding, so that every byte is covered by the checksum */
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t record_size;
+  uint32_t field_count;
+  uint8_t layout[8];
+  TraceSummary summary;
+  uint64_t checksum;
+};
+static_assert(sizeof(Header) == 96, "Binary trace headers must not be padded");
+
+/* Check whether the given bytes start with the binary trace magic number */
+bool has_magic(const char* data, size_t size);
+
+/* Make a header for a trace with the given summary, including its checksum */
+Header make_header(const TraceSummary& summary);
+
+/* Throw if the given header is of an unsupported version or layout, or is corrupt */
+void check_header(const Header& header);
+
+/* Read the summary from the header of a binary trace file. Returns nothing for files
+ * that have no summary, including text, compressed, and v1 binary traces */
+std::optional<TraceSummary> read_summary(const std::string& fname);
+
+/* Decode the record starting at `record`, which does not need to be aligned */
+inline MemoryRequest decode(const char* record) {
+  int tid, size, bundle_kind;
+  bool is_write;
+  uint64_t address, pc;
+
+  std::memcpy(&tid, record, sizeof(int));
+  std::memcpy(&size, record + sizeof(int), sizeof(int));
+  std::memcpy(&bundle_kind, record + 2 * sizeof(int), sizeof(int));
+  std::memcpy(&is_write, record + 3 * sizeof(int), sizeof(bool));
+  std::memcpy(&address, record + 3 * sizeof(int) + sizeof(bool), sizeof(uint64_t));
+  std::memcpy(&pc, record + 3 * sizeof(int) + sizeof(bool) + sizeof(uint64_t),
+              sizeof(uint64_t));
+
+  if (!MemoryRequest::fits(tid, size, bundle_kind))
+    throw std::out_of_range("Binary trace record does not fit the packed trace "
+                            "representation");
+  return MemoryRequest { tid, size, bundle_kind, is_write, address, pc };
+}
+
+/* Encode a request into the `RECORD_SIZE` bytes starting at `record` */
+inline void encode(const MemoryRequest& request, char* record) {
+  const int tid { request.tid }, size { request.size },
+      bundle_kind { request.bundle_kind };
+
+  std::memcpy(record, &tid, sizeof(int));
+  std::memcpy(record + sizeof(int), &size, sizeof(int));
+  std::memcpy(record + 2 * sizeof(int), &bundle_kind, sizeof(int));
+  std::memcpy(record + 3 * sizeof(int), &request.is_write, sizeof(bool));
+  std::memcpy(record + 3 * sizeof(int) + sizeof(bool), &request.address,
+              sizeof(uint64_t));
+  std::memcpy(record + 3 * sizeof(int) + sizeof(bool) + sizeof(uint64_t), &request.pc,
+              sizeof(uint64_t));
+}
+
+/* Writes a binary trace file one request at a time. Records are buffered and written out
+ * in large blocks */
+class Writer {
+  std::ofstream file;
+
+  const size_t buffer_records;
+  std::vector<char> buffer;
+  size_t buffered { 0 };
+
+  TraceSummariser summariser;
+  bool finished { false };
+
+  /* The exceptions in flight when this writer was made, to tell if one destroys it */
+  const int uncaught_exceptions;
+
+  void flush_buffer_();
+
+ public:
+  /* Records are written out `buffer_records` at a time */
+  explicit Writer(const std::string& fname,
+                  size_t buffer_records = WRITE_BUFFER_RECORDS);
+  ~Writer();
+
+  void write(const MemoryRequest& request) {
+    encode(request, buffer.data() + buffered * RECORD_SIZE);
+    summariser.add(request);
+    if (++buffered == buffer_records) flush_buffer_();
+  }
+
+  /* Write out the buffered records and the header. Called by the destructor if needed,
+   * but calling it explicitly reports errors. A writer destroyed by an exception leaves
+   * its header empty instead, so the partial trace can't pass for a complete one */
+  void finish();
+};
+}  // namespace BinaryTrace
+
+
+/* A binary trace file mapped into memory. Records are decoded in place from the page
+ * cache, with no intermediate copy of the file */
+class MappedBinaryTrace {
+  MappedFile file;
+  size_t length;
+  size_t records_offset;
+  std::optional<TraceSummary> summary;
+
+  const char* records() const;
+
+ public:
+  explicit MappedBinaryTrace(const std::string& fname);
+
+  /* The number of records in the trace */
+  size_t size() const;
+
+  /* The summary from the trace header, if it has one */
+  const std::optional<TraceSummary>& getSummary() const;
+
+  MemoryRequest operator[](size_t i) const {
+    return BinaryTrace::decode(records() + i * BinaryTrace::RECORD_SIZE);
+  }
+
+  /* Hint that the records in [first, first + count) will be read soon */
+  void willneed(size_t first, size_t count) const;
+
+  /* Hint that the records in [first, first + count) won't be read again */
+  void dontneed(size_t first, size_t count) const;
+
+  class const_iterator {
+    const char* record;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = MemoryRequest;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const MemoryRequest*;
+    using reference         = MemoryRequest;
+
+    explicit const_iterator(const char* record) : record(record) { }
+
+    MemoryRequest operator*() const { return BinaryTrace::decode(record); }
+    const_iterator& operator++() {
+      record += BinaryTrace::RECORD_SIZE;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto old = *this;
+      ++*this;
+      return old;
+    }
+    bool operator==(const const_iterator& other) const { return record == other.record; }
+    bool operator!=(const const_iterator& other) const { return record != other.record; }
+  };
+
+  const_iterator begin() const;
+  const_iterator end() const;
+};
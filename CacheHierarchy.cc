@@ -103,6 +103,30 @@ std::unique_ptr<std::map<uint64_t, uint64_t>> CacheHierarchy::getLifetimes(
   return levels[level - 1]->getLifetimes();
 }
 
+void CacheHierarchy::reset_stats() {
+  for (auto& level : levels) level->reset_stats();
+  std::fill(traffic.begin(), traffic.end(), 0);
+  bundles.clear();
+}
+
+void CacheHierarchy::pause_stats() {
+  if (stats_paused) return;
+  for (auto& level : levels) level->pause_stats();
+  paused_traffic.assign(traffic.size(), 0);
+  std::swap(traffic, paused_traffic);
+  std::swap(bundles, paused_bundles);
+  stats_paused = true;
+}
+
+void CacheHierarchy::resume_stats() {
+  if (!stats_paused) return;
+  for (auto& level : levels) level->resume_stats();
+  std::swap(traffic, paused_traffic);
+  std::swap(bundles, paused_bundles);
+  paused_bundles.clear();
+  stats_paused = false;
+}
+
 // ------
 
 void CacheHierarchy::touch(uint64_t address, int size,
@@ -111,7 +135,10 @@ void CacheHierarchy::touch(uint64_t address, int size,
 
   traffic[0] += size;
 
-  uint64_t next_address { address };
+  // Every level has lines of the same size, so they all number lines the same way, and
+  // each only has to split the line number into its own tag and set
+  uint64_t line { levels[0]->line_of(address) };
+  unsigned int block { levels[0]->block_of(address) };
   int remaining_size { size };
 
   while (remaining_size > 0) {
@@ -119,8 +146,7 @@ void CacheHierarchy::touch(uint64_t address, int size,
     // Go through cache levels in reverse order until either all accesses are hits or
     // we've reached the top level
     for (int current_level = 0; current_level < nlevels(); current_level++) {
-      // Find the first cache line this request touches
-      const auto& cache_address = levels[current_level]->split_address(next_address);
+      const auto& cache_address = levels[current_level]->split_line(line, block);
       const auto events         = levels[current_level]->touch(cache_address);
 
       // If counting writebacks as accesses, only break if the access is not a write
@@ -132,16 +158,15 @@ void CacheHierarchy::touch(uint64_t address, int size,
     }
 
     // Skip over the remaining bytes in this same cache line
-    const unsigned int covered_bytes =
-        line_size - levels[0]->split_address(next_address).block;
-    remaining_size -= covered_bytes;
-    next_address += covered_bytes;
+    remaining_size -= line_size - block;
+    line++;
+    block = 0;
   }
 
   clock_->tick();
 }
 
-void CacheHierarchy::touch(MemoryRequest request) {
+void CacheHierarchy::touch(const MemoryRequest& request) {
   if (request.is_bundle()) {
     bundles[request.pc].total_ops++;
     if (request.is_bundle_start()) bundles[request.pc].times_encountered++;
@@ -150,5 +175,40 @@ void CacheHierarchy::touch(MemoryRequest request) {
 }
 
 void CacheHierarchy::touch(const std::vector<MemoryRequest>& requests) {
+  touch(Span<const MemoryRequest> { requests });
+}
+
+void CacheHierarchy::touch(Span<const MemoryRequest> requests) {
   for (auto const& r : requests) touch(r);
 }
+
+void CacheHierarchy::touch(const RequestView& requests) {
+  touch(requests.begin(), requests.end());
+}
+
+void CacheHierarchy::touch(const RequestRun& run) {
+  const MemoryRequest& first = run.request;
+  if (first.is_bundle()) {
+    bundles[first.pc].total_ops += run.count;
+    bundles[first.pc].times_encountered += run.bundle_starts;
+  }
+  touch(first.address, first.size, first.is_write);
+  if (run.count == 1) return;
+
+  // The rest of the run hits the line the first request brought into L1. The clock must
+  // read the cycle of the last request in the run when it's accounted for, so that line
+  // lifetimes are the same as if each request had been run separately
+  const uint64_t repeats = run.count - 1;
+  traffic[0] += run.bytes - first.size;
+  clock_->advance(repeats - 1);
+  levels[0]->touch_repeated(levels[0]->split_address(first.address), repeats);
+  clock_->tick();
+}
+
+void CacheHierarchy::touch(const std::vector<RequestRun>& runs) {
+  touch(Span<const RequestRun> { runs });
+}
+
+void CacheHierarchy::touch(Span<const RequestRun> runs) {
+  for (auto const& run : runs) touch(run);
+}
@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <memory>
+#include <type_traits>
 
+#include "Span.hh"
 #include "cache.hh"
 
 
@@ -26,6 +28,11 @@ class CacheHierarchy {
    * ops */
   std::map<uint64_t, BundleStats> bundles;
 
+  /* The stats put aside by `pause_stats` */
+  std::vector<uint64_t> paused_traffic;
+  std::map<uint64_t, BundleStats> paused_bundles;
+  bool stats_paused { false };
+
   /* A counter of how many requests this hierarchy has serviced so far. Each cache level
    can read this shared counter, but only the hierarchy can cause it to tick */
   const std::shared_ptr<Clock> clock_;
@@ -65,14 +72,46 @@ class CacheHierarchy {
    * being evicted */
   std::unique_ptr<std::map<uint64_t, uint64_t>> getLifetimes(int level) const;
 
+  /* Clear all the stats, keeping the contents of the caches. Used to exclude warm-up
+   * requests from the results */
+  void reset_stats();
+
+  /* Stop counting stats until `resume_stats` is called, while the requests run in between
+   * still update the contents of the caches. Used to warm caches up between the samples
+   * of a sampled simulation. Pausing or resuming twice has no further effect */
+  void pause_stats();
+  void resume_stats();
+
 
   /* Accesses*/
   /* Run a single request through the cache hierarchy */
   void touch(uint64_t address, int size = 1, bool is_write = false);
 
   /* Run a single request through the cache hierarchy */
-  void touch(MemoryRequest request);
+  void touch(const MemoryRequest& request);
 
   /* Run a sequence of requests through the cache hierarchy */
   void touch(const std::vector<MemoryRequest>& requests);
+
+  /* Run a sequence of requests through the cache hierarchy, without copying them */
+  void touch(Span<const MemoryRequest> requests);
+
+  /* Run the requests in a trace through the cache hierarchy, decoding them on the fly */
+  void touch(const RequestView& requests);
+
+  /* Run a run of requests to the same line through the cache hierarchy, as one lookup
+   * followed by guaranteed L1 hits. The results are the same as running each request in
+   * the run, provided runs were compacted to the L1 line size (see `compact_runs`) */
+  void touch(const RequestRun& run);
+
+  /* Run a sequence of compacted runs through the cache hierarchy */
+  void touch(const std::vector<RequestRun>& runs);
+  void touch(Span<const RequestRun> runs);
+
+  /* Run the requests in [first, last) through the cache hierarchy. Works with any
+   * iterator that yields `MemoryRequest`s, including ones that decode on the fly */
+  template <typename Iterator, typename = std::enable_if_t<!std::is_integral_v<Iterator>>>
+  void touch(Iterator first, Iterator last) {
+    for (; first != last; ++first) touch(static_cast<const MemoryRequest&>(*first));
+  }
 };
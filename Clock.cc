@@ -7,3 +7,7 @@ uint64_t Clock::current_cycle() const {
 void Clock::tick() {
   current_cycle_++;
 }
+
+void Clock::advance(uint64_t cycles) {
+  current_cycle_ += cycles;
+}
@@ -8,4 +8,7 @@ class Clock {
  public:
   uint64_t current_cycle() const;
   void tick();
+
+  /* Advance the clock by `cycles` ticks at once */
+  void advance(uint64_t cycles);
 };
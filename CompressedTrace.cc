@@ -0,0 +1,287 @@
+#include "CompressedTrace.hh"
+
+#include <cstring>
+#include <exception>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+namespace CompressedTrace {
+namespace {
+
+#define FLAG_IS_WRITE   0x01
+#define FLAG_SAME_SIZES 0x10
+
+void put_varint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+uint64_t get_varint(const char*& in, const char* end) {
+  uint64_t value { 0 };
+  for (int shift = 0; shift < 64; shift += 7) {
+    if (in == end) throw std::runtime_error("Compressed trace block is truncated");
+
+    const auto byte = static_cast<uint8_t>(*in++);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if (!(byte & 0x80)) return value;
+  }
+  throw std::runtime_error("Malformed varint in compressed trace");
+}
+
+uint64_t zigzag(uint64_t delta) {
+  return (delta << 1) ^ static_cast<uint64_t>(static_cast<int64_t>(delta) >> 63);
+}
+
+uint64_t unzigzag(uint64_t value) { return (value >> 1) ^ (~(value & 1) + 1); }
+
+/* Append the encoding of `request` to `out`, given the previous request in its block */
+void encode_record(std::string& out, const MemoryRequest& request,
+                   const MemoryRequest& previous, bool block_start) {
+  const bool same_sizes =
+      !block_start && request.tid == previous.tid && request.size == previous.size;
+  const uint8_t flags = (request.is_write ? FLAG_IS_WRITE : 0) |
+                        (request.bundle_kind & 0x7) << 1 |
+                        (same_sizes ? FLAG_SAME_SIZES : 0);
+  out.push_back(static_cast<char>(flags));
+
+  if (!same_sizes) {
+    put_varint(out, request.tid);
+    put_varint(out, request.size);
+  }
+  put_varint(out, zigzag(request.address - previous.address));
+  put_varint(out, zigzag(request.pc - previous.pc));
+}
+
+}  // namespace
+
+
+bool has_magic(const char* data, size_t size) {
+  return size >= sizeof(MAGIC) && std::memcmp(data, MAGIC, sizeof(MAGIC)) == 0;
+}
+
+// ------
+
+Decoder::Decoder(const char* data, size_t size) : data(data), data_size(size) {
+  if (size < sizeof(Header) || !has_magic(data, size))
+    throw std::invalid_argument("Not a compressed trace file");
+
+  std::memcpy(&header, data, sizeof(Header));
+  if (header.version != VERSION)
+    throw std::invalid_argument("Unsupported compressed trace version: " +
+                                std::to_string(header.version));
+  if (header.block_size == 0)
+    throw std::invalid_argument("Compressed trace has an invalid block size");
+
+  // The counts are checked by division, so that corrupt ones can't overflow
+  if (header.index_offset > size ||
+      (size - header.index_offset) / sizeof(uint64_t) <= header.block_count)
+    throw std::invalid_argument("Compressed trace index is truncated");
+  const uint64_t full_blocks = header.record_count / header.block_size;
+  if (header.block_count != full_blocks + (header.record_count % header.block_size != 0))
+    throw std::invalid_argument("Compressed trace has the wrong number of blocks");
+  const uint64_t index_bytes = (header.block_count + 1) * sizeof(uint64_t);
+
+  offsets.resize(header.block_count + 1);
+  std::memcpy(offsets.data(), data + header.index_offset, index_bytes);
+
+  for (uint64_t b = 0; b < header.block_count; b++)
+    if (offsets[b] > offsets[b + 1] || offsets[b + 1] > header.index_offset)
+      throw std::invalid_argument("Compressed trace index is corrupt");
+}
+
+uint64_t Decoder::size() const { return header.record_count; }
+uint32_t Decoder::block_size() const { return header.block_size; }
+uint64_t Decoder::nblocks() const { return header.block_count; }
+
+uint64_t Decoder::block_first(uint64_t block) const { return block * header.block_size; }
+
+size_t Decoder::block_records(uint64_t block) const {
+  const uint64_t first = block_first(block);
+  return std::min<uint64_t>(header.block_size, header.record_count - first);
+}
+
+uint64_t Decoder::find_block(uint64_t record) const { return record / header.block_size; }
+
+uint64_t Decoder::block_offset(uint64_t block) const { return offsets.at(block); }
+
+uint64_t Decoder::block_bytes(uint64_t block) const {
+  return offsets.at(block + 1) - offsets.at(block);
+}
+
+size_t Decoder::decode_block(uint64_t block, MemoryRequest* out) const {
+  const char* in        = data + block_offset(block);
+  const char* const end = in + block_bytes(block);
+  const size_t n        = block_records(block);
+
+  int64_t tid { 0 }, size { 0 };
+  uint64_t address { 0 }, pc { 0 };
+  for (size_t i = 0; i < n; i++) {
+    if (in == end) throw std::runtime_error("Compressed trace block is truncated");
+    const auto flags = static_cast<uint8_t>(*in++);
+
+    // Varints too large for an int64_t turn negative, which `fits` rejects as well
+    if (!(flags & FLAG_SAME_SIZES)) {
+      tid  = static_cast<int64_t>(get_varint(in, end));
+      size = static_cast<int64_t>(get_varint(in, end));
+      if (!MemoryRequest::fits(tid, size, 0))
+        throw std::out_of_range("Compressed trace record does not fit the packed trace "
+                                "representation");
+    }
+    address += unzigzag(get_varint(in, end));
+    pc += unzigzag(get_varint(in, end));
+
+    out[i] = MemoryRequest { static_cast<int>(tid), static_cast<int>(size),
+                             (flags >> 1) & 0x7, (flags & FLAG_IS_WRITE) != 0, address,
+                             pc };
+  }
+
+  return n;
+}
+
+// ------
+
+Writer::Writer(const std::string& fname, uint32_t block_size)
+    : file(fname, std::ios::binary),
+      block_size(block_size),
+      uncaught_exceptions(std::uncaught_exceptions()) {
+  if (!file.is_open()) throw std::invalid_argument("Cannot open output file: " + fname);
+  if (block_size == 0) throw std::invalid_argument("Block size must not be 0");
+
+  // The header is rewritten with the final counts once the trace is complete
+  const Header header {};
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  offsets.push_back(sizeof(Header));
+}
+
+Writer::~Writer() {
+  if (std::uncaught_exceptions() > uncaught_exceptions) return;
+  try {
+    finish();
+  } catch (...) {
+  }
+}
+
+void Writer::write(const MemoryRequest& request) {
+  // Deltas restart at every block, so that blocks can be decoded independently
+  if (block_records == 0) previous = MemoryRequest {};
+
+  encode_record(block, request, previous, block_records == 0);
+
+  previous = request;
+  record_count++;
+  if (++block_records == block_size) flush_block_();
+}
+
+void Writer::flush_block_() {
+  if (block_records == 0) return;
+
+  file.write(block.data(), block.size());
+  offsets.push_back(offsets.back() + block.size());
+
+  block.clear();
+  block_records = 0;
+}
+
+void Writer::finish() {
+  if (finished) return;
+  finished = true;
+
+  flush_block_();
+
+  Header header;
+  std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version      = VERSION;
+  header.block_size   = block_size;
+  header.record_count = record_count;
+  header.block_count  = offsets.size() - 1;
+  header.index_offset = offsets.back();
+
+  file.write(reinterpret_cast<const char*>(offsets.data()),
+             offsets.size() * sizeof(uint64_t));
+  file.seekp(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(Header));
+  file.close();
+
+  if (file.fail()) throw std::runtime_error("Failed to write compressed trace");
+}
+}  // namespace CompressedTrace
+
+// ------
+
+MappedCompressedTrace::MappedCompressedTrace(const std::string& fname)
+    : file(fname), decoder(file.data(), file.size()) {
+  file.advise(MADV_SEQUENTIAL);
+}
+
+const CompressedTrace::Decoder& MappedCompressedTrace::getDecoder() const {
+  return decoder;
+}
+
+void MappedCompressedTrace::willneed(uint64_t first_block, uint64_t nblocks) const {
+  if (nblocks == 0) return;
+  const auto start = decoder.block_offset(first_block);
+  file.advise(MADV_WILLNEED, start,
+              decoder.block_offset(first_block + nblocks) - start);
+}
+
+void MappedCompressedTrace::dontneed(uint64_t first_block, uint64_t nblocks) const {
+  if (nblocks == 0) return;
+  const auto start = decoder.block_offset(first_block);
+  file.advise(MADV_DONTNEED, start, decoder.block_offset(first_block + nblocks) - start);
+}
+
+// ------
+
+CompressedTraceBuffer::CompressedTraceBuffer(const RequestView& requests,
+                                             uint32_t block_size) {
+  if (block_size == 0) throw std::invalid_argument("Block size must not be 0");
+
+  // Blocks are independent, so they are encoded in parallel and then laid out in order
+  const uint64_t nblocks = (requests.size() + block_size - 1) / block_size;
+  std::vector<std::string> blocks(nblocks);
+
+#pragma omp parallel for schedule(dynamic)
+  for (uint64_t b = 0; b < nblocks; b++) {
+    const auto block_requests = requests.subspan(b * block_size, block_size);
+    MemoryRequest previous {};
+    for (size_t i = 0; i < block_requests.size(); i++) {
+      const MemoryRequest request = block_requests[i];
+      CompressedTrace::encode_record(blocks[b], request, previous, i == 0);
+      previous = request;
+    }
+  }
+
+  std::vector<uint64_t> offsets { sizeof(CompressedTrace::Header) };
+  for (const auto& block : blocks) offsets.push_back(offsets.back() + block.size());
+
+  CompressedTrace::Header header;
+  std::memcpy(header.magic, CompressedTrace::MAGIC, sizeof(CompressedTrace::MAGIC));
+  header.version      = CompressedTrace::VERSION;
+  header.block_size   = block_size;
+  header.record_count = requests.size();
+  header.block_count  = nblocks;
+  header.index_offset = offsets.back();
+
+  data.reserve(offsets.back() + offsets.size() * sizeof(uint64_t));
+  data.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  for (auto& block : blocks) {
+    data += block;
+    block = std::string {};
+  }
+  data.append(reinterpret_cast<const char*>(offsets.data()),
+              offsets.size() * sizeof(uint64_t));
+
+  decoder.emplace(data.data(), data.size());
+}
+
+const CompressedTrace::Decoder& CompressedTraceBuffer::getDecoder() const {
+  return *decoder;
+}
+
+size_t CompressedTraceBuffer::size() const { return decoder->size(); }
+
+size_t CompressedTraceBuffer::bytes() const { return data.size(); }
@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hh"
+#include "MemoryTrace.hh"
+
+/* The compressed, block-indexed binary trace format (v2).
+ *
+ * A file starts with a fixed `Header`, followed by blocks of up to `block_size` records,
+ * followed by an index of `block_count + 1` file offsets, one for the start of each block
+ * and one for the end of the last. Each block is independent: its deltas start from
+ * zero, so any block can be decoded on its own, in any order.
+ *
+ * Each record is a flags byte, followed by LEB128 varints:
+ *   flags: bit 0 is_write, bits 1-3 bundle_kind, bit 4 set if tid and size are the same
+ *          as in the previous record
+ *   [tid, size]                  only if bit 4 of flags is clear
+ *   zigzag(address - previous address)
+ *   zigzag(pc - previous pc) */
+namespace CompressedTrace {
+
+constexpr char MAGIC[8]               = { 'S', 'C', 'S', 'T', 'R', 'A', 'C', 'E' };
+constexpr uint32_t VERSION            = 2;
+constexpr uint32_t DEFAULT_BLOCK_SIZE = DEFAULT_COMPRESSED_BLOCK_SIZE;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t block_size;
+  uint64_t record_count;
+  uint64_t block_count;
+  uint64_t index_offset;
+};
+
+/* Check whether the given bytes start with the compressed trace magic number */
+bool has_magic(const char* data, size_t size);
+
+/* Decodes blocks from a compressed trace file held in memory */
+class Decoder {
+  const char* data;
+  size_t data_size;
+  Header header;
+  std::vector<uint64_t> offsets;
+
+ public:
+  /* Validate the header and index of the trace in [data, data + size) */
+  Decoder(const char* data, size_t size);
+
+  /* The total number of records in the trace */
+  uint64_t size() const;
+
+  /* The maximum number of records in a block */
+  uint32_t block_size() const;
+
+  uint64_t nblocks() const;
+
+  /* The index of the first record in the given block */
+  uint64_t block_first(uint64_t block) const;
+
+  /* The number of records in the given block */
+  size_t block_records(uint64_t block) const;
+
+  /* The block holding the given record */
+  uint64_t find_block(uint64_t record) const;
+
+  /* Decode all the records in the given block into `out`, which must have room for
+   * `block_records(block)` requests. Returns the number of requests decoded */
+  size_t decode_block(uint64_t block, MemoryRequest* out) const;
+
+  /* The offset and length in bytes of the given block within the file */
+  uint64_t block_offset(uint64_t block) const;
+  uint64_t block_bytes(uint64_t block) const;
+};
+
+/* Writes a compressed trace file one request at a time */
+class Writer {
+  std::ofstream file;
+  const uint32_t block_size;
+
+  std::string block;
+  uint32_t block_records { 0 };
+  MemoryRequest previous {};
+
+  uint64_t record_count { 0 };
+  std::vector<uint64_t> offsets;
+  bool finished { false };
+
+  /* The exceptions in flight when this writer was made, to tell if one destroys it */
+  const int uncaught_exceptions;
+
+  void flush_block_();
+
+ public:
+  explicit Writer(const std::string& fname, uint32_t block_size = DEFAULT_BLOCK_SIZE);
+  ~Writer();
+
+  void write(const MemoryRequest& request);
+
+  /* Write out the last block and the index. Called by the destructor if needed, but
+   * calling it explicitly reports errors. A writer destroyed by an exception leaves its
+   * header empty instead, so the partial trace can't pass for a complete one */
+  void finish();
+};
+}  // namespace CompressedTrace
+
+
+/* A compressed trace file mapped into memory */
+class MappedCompressedTrace {
+  MappedFile file;
+  CompressedTrace::Decoder decoder;
+
+ public:
+  explicit MappedCompressedTrace(const std::string& fname);
+
+  const CompressedTrace::Decoder& getDecoder() const;
+
+  /* Hint that the given blocks will be read soon, or won't be read again */
+  void willneed(uint64_t first_block, uint64_t nblocks) const;
+  void dontneed(uint64_t first_block, uint64_t nblocks) const;
+};
+
+
+/* A trace held in memory in the compressed format, which typically takes several times
+ * less memory than a `MemoryTrace`. Any number of threads can decode its blocks at once,
+ * each into a buffer of its own */
+class CompressedTraceBuffer {
+  std::string data;
+
+  /* Refers to `data`, so buffers can be neither copied nor moved */
+  std::optional<CompressedTrace::Decoder> decoder;
+
+ public:
+  explicit CompressedTraceBuffer(
+      const RequestView& requests,
+      uint32_t block_size = CompressedTrace::DEFAULT_BLOCK_SIZE);
+  CompressedTraceBuffer(const CompressedTraceBuffer&) = delete;
+  CompressedTraceBuffer& operator=(const CompressedTraceBuffer&) = delete;
+
+  const CompressedTrace::Decoder& getDecoder() const;
+
+  /* The number of requests in the trace */
+  size_t size() const;
+
+  /* The size of the compressed trace in bytes */
+  size_t bytes() const;
+};
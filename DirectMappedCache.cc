@@ -26,6 +26,12 @@ CacheEvents DirectMappedCache::touch(const CacheAddress& cache_address) {
   return events;
 }
 
+void DirectMappedCache::touch_repeated(const CacheAddress& cache_address, uint64_t n) {
+  // Every touch reloads the line, so only the last one matters
+  cache_lines[cache_address.index].set(cache_address.tag, clock_->current_cycle());
+  hits += n;
+}
+
 /* Returns a a liftime map for the elements still in the cache */
 std::unique_ptr<std::map<uint64_t, uint64_t>> DirectMappedCache::getActiveLifetimes()
     const {
@@ -16,5 +16,6 @@ class DirectMappedCache : public Cache {
 
   using Cache::touch;
   virtual CacheEvents touch(const CacheAddress& address) override;
+  virtual void touch_repeated(const CacheAddress& address, uint64_t n) override;
   virtual CacheType getType() const override;
 };
@@ -0,0 +1,152 @@
+#include "ForeignTrace.hh"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+namespace LackeyTrace {
+namespace {
+
+/* Lines of Valgrind's own messages, rather than of accesses */
+bool is_message(std::string_view line) {
+  return line.size() >= 2 && ((line[0] == '=' && line[1] == '=') ||
+                              (line[0] == '-' && line[1] == '-'));
+}
+
+/* Parse a line into the kind of access (I, L, S, or M), its address, and its size.
+ * Returns false for lines with no access */
+bool parse_line(std::string_view line, char& kind, uint64_t& address, int& size) {
+  if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+  if (line.empty() || is_message(line)) return false;
+
+  if (line.size() > 3 && line[0] == 'I' && line[1] == ' ')
+    kind = 'I';
+  else if (line.size() > 3 && line[0] == ' ' && line[2] == ' ' &&
+           (line[1] == 'L' || line[1] == 'S' || line[1] == 'M'))
+    kind = line[1];
+  else
+    throw std::invalid_argument("Malformed Lackey trace line: " + std::string(line));
+
+  const char* pos       = line.data() + 2;
+  const char* const end = line.data() + line.size();
+  while (pos != end && *pos == ' ') pos++;
+
+  auto result = std::from_chars(pos, end, address, 16);
+  if (result.ec == std::errc() && result.ptr != end && *result.ptr == ',')
+    result = std::from_chars(result.ptr + 1, end, size, 10);
+  else
+    result.ec = std::errc::invalid_argument;
+  if (result.ec != std::errc())
+    throw std::invalid_argument("Malformed Lackey trace line: " + std::string(line));
+
+  return true;
+}
+}  // namespace
+
+bool has_signature(const char* data, size_t size) {
+  const std::string_view text { data, size };
+  for (size_t pos = 0; pos < text.size();) {
+    const size_t eol            = std::min(text.find('\n', pos), text.size());
+    const std::string_view line = text.substr(pos, eol - pos);
+    pos                         = eol + 1;
+
+    if (is_message(line)) {
+      if (line.find("Lackey") != std::string_view::npos) return true;
+      continue;
+    }
+    return line.size() > 3 && ((line[0] == 'I' && line[1] == ' ') ||
+                               (line[0] == ' ' && line[2] == ' ' &&
+                                (line[1] == 'L' || line[1] == 'S' || line[1] == 'M')));
+  }
+  return false;
+}
+
+size_t Reader::read(MemoryRequest* out, size_t max) {
+  size_t n { 0 };
+  if (pending && max > 0) {
+    out[n++] = *pending;
+    pending.reset();
+  }
+
+  char kind;
+  uint64_t address;
+  int size;
+  while (n < max && std::getline(in, line)) {
+    if (!parse_line(line, kind, address, size)) continue;
+    if (kind == 'I') {
+      pc = address;
+      continue;
+    }
+    if (!MemoryRequest::fits(0, size, 0))
+      throw std::out_of_range("Lackey access is too large: " + line);
+
+    out[n++] = MemoryRequest { 0, size, 0, kind == 'S', address, pc };
+    if (kind == 'M') {
+      const MemoryRequest store { 0, size, 0, true, address, pc };
+      if (n < max)
+        out[n++] = store;
+      else
+        pending = store;
+    }
+  }
+  return n;
+}
+}  // namespace LackeyTrace
+
+// ------
+
+namespace DrCacheSimTrace {
+namespace {
+
+/* Records are read in batches of at most this many */
+constexpr size_t READ_BATCH_RECORDS = 1 << 14;
+
+uint16_t record_type(const char* record) {
+  uint16_t type;
+  std::memcpy(&type, record, sizeof(type));
+  return type;
+}
+}  // namespace
+
+bool has_signature(const char* data, size_t size) {
+  if (size < 2 * RECORD_SIZE || record_type(data) != TYPE_HEADER) return false;
+
+  const uint16_t next = record_type(data + RECORD_SIZE);
+  return next == TYPE_THREAD || next == TYPE_PID || next == TYPE_MARKER;
+}
+
+size_t Reader::read(MemoryRequest* out, size_t max) {
+  size_t n { 0 };
+  while (n < max) {
+    // Each record gives at most one request, so reading no more records than there is
+    // room for never leaves requests over
+    buffer.resize(std::min(max - n, READ_BATCH_RECORDS) * RECORD_SIZE);
+    in.read(buffer.data(), buffer.size());
+    const size_t records = in.gcount() / RECORD_SIZE;
+    if (records == 0) break;
+
+    const char* const end = buffer.data() + records * RECORD_SIZE;
+    for (const char* record = buffer.data(); record != end; record += RECORD_SIZE) {
+      const uint16_t type = record_type(record);
+      uint16_t size;
+      uint64_t address;
+      std::memcpy(&size, record + 2, sizeof(size));
+      std::memcpy(&address, record + 4, sizeof(address));
+
+      if (type == TYPE_READ || type == TYPE_WRITE ||
+          (type >= TYPE_PREFETCH && type <= TYPE_PREFETCH_WRITE)) {
+        if (!MemoryRequest::fits(tid, size, 0))
+          throw std::out_of_range("drcachesim access is too large, or from too many "
+                                  "threads");
+        out[n++] = MemoryRequest { tid, size, 0, type == TYPE_WRITE, address, pc };
+      } else if (type >= TYPE_INSTR && type <= TYPE_INSTR_RETURN)
+        pc = address;
+      else if (type == TYPE_THREAD)
+        tid = tids.try_emplace(address, static_cast<int>(tids.size())).first->second;
+    }
+  }
+  return n;
+}
+}  // namespace DrCacheSimTrace
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <istream>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "MemoryTrace.hh"
+
+/* Memory traces written by other tools, decoded straight into requests as they are read.
+ * Neither format records scatter/gather bundles, so every request is a scalar access */
+
+/* The output of Valgrind's Lackey tool with `--trace-mem=yes`: one access per line, as
+ * `I  ADDR,SIZE` for an instruction fetch, or ` L ADDR,SIZE`, ` S ADDR,SIZE`, or
+ * ` M ADDR,SIZE` for a load, a store, or a load and store (modify) of data. Addresses
+ * are in hex, without a prefix. Valgrind's own `==PID==` messages are ignored.
+ *
+ * Instruction fetches are not simulated, but give the PC of the data accesses after
+ * them. Lackey doesn't record threads, so every request comes from thread 0 */
+namespace LackeyTrace {
+
+/* Check whether the given bytes start like Lackey output */
+bool has_signature(const char* data, size_t size);
+
+/* Reads requests from Lackey output */
+class Reader {
+  std::istream& in;
+  std::string line;
+  uint64_t pc { 0 };
+
+  /* The store half of a modify, when there was no room left for it */
+  std::optional<MemoryRequest> pending;
+
+ public:
+  explicit Reader(std::istream& in) : in(in) { }
+
+  /* Read up to `max` requests into `out`. Returns the number of requests read, which is
+   * only 0 at the end of the trace. Throws on lines that aren't Lackey output */
+  size_t read(MemoryRequest* out, size_t max);
+};
+}  // namespace LackeyTrace
+
+/* The raw records of a DynamoRIO drcachesim trace: packed 12-byte `trace_entry_t`s of a
+ * 16-bit type, a 16-bit size, and a 64-bit address. Only 64-bit little-endian traces
+ * in the uncompressed record format (as written by the online tracer, or by `raw2trace`
+ * without compression) are read.
+ *
+ * Loads, stores, and software prefetches are simulated, prefetches as loads. Instruction
+ * records give the PC of the data records after them, and thread records their tid.
+ * Thread ids are numbered from 0 in the order they first appear */
+namespace DrCacheSimTrace {
+
+constexpr size_t RECORD_SIZE = 12;
+
+/* The `trace_type_t` values that matter here */
+constexpr uint16_t TYPE_READ           = 0;
+constexpr uint16_t TYPE_WRITE          = 1;
+constexpr uint16_t TYPE_PREFETCH       = 2;
+constexpr uint16_t TYPE_PREFETCH_WRITE = 8;
+constexpr uint16_t TYPE_INSTR          = 10;
+constexpr uint16_t TYPE_INSTR_RETURN   = 16;
+constexpr uint16_t TYPE_THREAD         = 22;
+constexpr uint16_t TYPE_PID            = 24;
+constexpr uint16_t TYPE_HEADER         = 25;
+constexpr uint16_t TYPE_MARKER         = 28;
+
+/* Check whether the given bytes start with a drcachesim trace header */
+bool has_signature(const char* data, size_t size);
+
+/* Reads requests from drcachesim records */
+class Reader {
+  std::istream& in;
+  std::vector<char> buffer;
+  uint64_t pc { 0 };
+  int tid { 0 };
+  std::unordered_map<uint64_t, int> tids;
+
+ public:
+  explicit Reader(std::istream& in) : in(in) { }
+
+  /* Read up to `max` requests into `out`. Returns the number of requests read, which is
+   * only 0 at the end of the trace */
+  size_t read(MemoryRequest* out, size_t max);
+};
+}  // namespace DrCacheSimTrace
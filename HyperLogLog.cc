@@ -0,0 +1,39 @@
+#include "HyperLogLog.hh"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+HyperLogLog::HyperLogLog(int precision) : precision(precision) {
+  if (precision < 4 || precision > 18)
+    throw std::invalid_argument("HyperLogLog precision must be between 4 and 18");
+  registers.resize(size_t { 1 } << precision);
+}
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+  if (other.precision != precision)
+    throw std::invalid_argument("HyperLogLog sketches must have the same precision");
+
+  for (size_t i = 0; i < registers.size(); i++)
+    registers[i] = std::max(registers[i], other.registers[i]);
+}
+
+uint64_t HyperLogLog::estimate() const {
+  const double m = registers.size();
+
+  double inverse_sum { 0 };
+  size_t zeros { 0 };
+  for (const auto reg : registers) {
+    inverse_sum += std::ldexp(1.0, -reg);
+    zeros += reg == 0;
+  }
+
+  const double alpha = 0.7213 / (1 + 1.079 / m);
+  double estimate    = alpha * m * m / inverse_sum;
+
+  // The raw estimate is biased for small counts, where linear counting of the empty
+  // registers is much more accurate. 64-bit hashes need no large range correction
+  if (estimate <= 2.5 * m && zeros > 0) estimate = m * std::log(m / zeros);
+
+  return static_cast<uint64_t>(std::llround(estimate));
+}
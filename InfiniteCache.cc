@@ -18,6 +18,11 @@ CacheEvents InfiniteCache::touch(const CacheAddress& cache_address) {
   return events;
 }
 
+void InfiniteCache::touch_repeated(__attribute__((unused)) const CacheAddress& address,
+                                   uint64_t n) {
+  hits += n;
+}
+
 /* Returns a a liftime map for the elements still in the cache */
 std::unique_ptr<std::map<uint64_t, uint64_t>> InfiniteCache::getActiveLifetimes() const {
   throw std::logic_error("Infinite caches don't implement lifetimes");
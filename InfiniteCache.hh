@@ -15,5 +15,6 @@ class InfiniteCache : public Cache {
 
   using Cache::touch;
   virtual CacheEvents touch(const CacheAddress& address) override;
+  virtual void touch_repeated(const CacheAddress& address, uint64_t n) override;
   virtual CacheType getType() const override;
 };
@@ -0,0 +1,67 @@
+#include "MappedFile.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile(const std::string& fname) {
+  const int fd = open(fname.c_str(), O_RDONLY);
+  if (fd < 0) throw std::invalid_argument("Cannot open trace file: " + fname);
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    throw std::runtime_error("Cannot stat file: " + fname + ": " + std::strerror(errno));
+  }
+  size_ = st.st_size;
+
+  // mmap(2) rejects zero-length mappings, so empty files are just left unmapped
+  if (size_ > 0) {
+    void* addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (addr == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("Cannot map file: " + fname + ": " + std::strerror(errno));
+    }
+    data_ = static_cast<const char*>(addr);
+  }
+
+  // The mapping stays valid after the descriptor is closed
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) munmap(const_cast<char*>(data_), size_);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)) { }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+  if (this != &other) {
+    if (data_) munmap(const_cast<char*>(data_), size_);
+    data_ = std::exchange(other.data_, nullptr);
+    size_ = std::exchange(other.size_, 0);
+  }
+  return *this;
+}
+
+const char* MappedFile::data() const { return data_; }
+size_t MappedFile::size() const { return size_; }
+
+void MappedFile::advise(int advice, size_t offset, size_t length) const {
+  if (!data_ || offset >= size_) return;
+
+  // madvise(2) requires a page-aligned start address
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  const size_t aligned_offset   = offset - offset % page_size;
+  const size_t end              = std::min(size_, offset + std::min(length, size_ - offset));
+
+  madvise(const_cast<char*>(data_) + aligned_offset, end - aligned_offset, advice);
+}
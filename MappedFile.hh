@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/* A read-only memory mapping of a whole file. The mapping is shared, so several
+ * processes mapping the same file use the same pages in the page cache */
+class MappedFile {
+  const char* data_ { nullptr };
+  size_t size_ { 0 };
+
+ public:
+  explicit MappedFile(const std::string& fname);
+  ~MappedFile();
+
+  MappedFile(const MappedFile&) = delete;
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+  MappedFile& operator=(MappedFile&& other) noexcept;
+
+  const char* data() const;
+  size_t size() const;
+
+  /* Pass an madvise(2) hint to the kernel for the given byte range of the file.
+   * Hints are best-effort, so failures are ignored */
+  void advise(int advice, size_t offset = 0, size_t length = SIZE_MAX) const;
+};
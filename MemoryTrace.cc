@@ -1,22 +1,32 @@
 #include <algorithm>
 #include <cassert>
+#include <charconv>
 #include <cmath>
 #include <cstring>
+#include <exception>
 #include <sstream>
 #include <string>
 #include <thread>
 
+#include "BinaryTrace.hh"
+#include "CompressedTrace.hh"
+#include "ForeignTrace.hh"
+#include "MappedFile.hh"
 #include "MemoryTrace.hh"
+#include "ShmRing.hh"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 MemoryRequest::MemoryRequest(const int tid, const int size, const int bundle_kind,
                              const bool is_write, const uint64_t address,
                              const uint64_t pc)
-    : tid(tid),
+    : address(address),
+      pc(pc),
+      tid(tid),
       size(size),
       bundle_kind(bundle_kind),
-      is_write(is_write),
-      address(address),
-      pc(pc) { }
+      is_write(is_write) { }
 
 bool MemoryRequest::is_bundle() const { return bundle_kind != 0; }
 bool MemoryRequest::is_bundle_start() const { return bundle_kind & 0x1; }
@@ -24,6 +34,70 @@ bool MemoryRequest::is_bundle_middle() const { return bundle_kind & 0x2; }
 bool MemoryRequest::is_bundle_end() const { return bundle_kind & 0x4; }
 
 
+bool TraceFilter::empty() const {
+  return !tid && !is_write && pc_min == 0 && pc_max == UINT64_MAX && address_min == 0 &&
+         address_max == UINT64_MAX && bundle_kinds == 0xff;
+}
+
+void TraceSummariser::add(const MemoryRequest& request) {
+  summary.record_count++;
+  if (request.is_bundle_start()) summary.bundle_count++;
+  summary.min_address = std::min(summary.min_address, request.address);
+  summary.max_address = std::max(summary.max_address, request.address);
+  addresses.add(request.address);
+  lines_64.add(request.address >> 6);
+  lines_256.add(request.address >> 8);
+}
+
+void TraceSummariser::merge(const TraceSummariser& other) {
+  summary.record_count += other.summary.record_count;
+  summary.bundle_count += other.summary.bundle_count;
+  summary.min_address = std::min(summary.min_address, other.summary.min_address);
+  summary.max_address = std::max(summary.max_address, other.summary.max_address);
+  addresses.merge(other.addresses);
+  lines_64.merge(other.lines_64);
+  lines_256.merge(other.lines_256);
+}
+
+TraceSummary TraceSummariser::get() const {
+  TraceSummary result     = summary;
+  result.unique_addresses = addresses.estimate();
+  result.unique_lines_64  = lines_64.estimate();
+  result.unique_lines_256 = lines_256.estimate();
+  return result;
+}
+
+
+namespace {
+
+/* Skip over the commas and blanks between text trace fields */
+inline const char* skip_separators(const char* pos, const char* end) {
+  while (pos != end && (*pos == ',' || *pos == ' ' || *pos == '\t' || *pos == '\r'))
+    pos++;
+  return pos;
+}
+
+/* Parse the next field of a text trace line. Hexadecimal fields may have a 0x prefix */
+template <typename T>
+inline const char* parse_field(const char* pos, const char* end, T& value, int base) {
+  pos = skip_separators(pos, end);
+  if (base == 16 && end - pos >= 2 && pos[0] == '0' && (pos[1] == 'x' || pos[1] == 'X'))
+    pos += 2;
+
+  const auto [next, ec] = std::from_chars(pos, end, value, base);
+  if (ec != std::errc()) throw std::invalid_argument("Malformed trace field");
+  return next;
+}
+
+/* Returns the end of the line starting at `pos`, excluding the newline */
+inline const char* line_end(const char* pos, const char* end) {
+  const auto newline = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+  return newline ? newline : end;
+}
+
+}  // namespace
+
+
 namespace MemoryTraceTools {
 
 /* Guess if the given file is a text file */
@@ -33,19 +107,77 @@ TraceFileType guess_file_type(const std::string& fname) {
   if (!f.is_open()) throw std::invalid_argument("Cannot open trace file: " + fname);
 
   size_t check_count { 500 };
-  std::unique_ptr<char> data { new char[check_count + 1] };
+  std::unique_ptr<char[]> data { new char[check_count + 1] };
   f.read(data.get(), check_count);
 
   if (f.eof()) check_count = f.gcount();
-  if (std::memchr(data.get(), '\0', check_count) != NULL)
+  if (CompressedTrace::has_magic(data.get(), check_count))
+    return TraceFileType::Compressed;
+  else if (BinaryTrace::has_magic(data.get(), check_count))
+    return TraceFileType::Binary;
+  else if (DrCacheSimTrace::has_signature(data.get(), check_count))
+    return TraceFileType::DrCacheSim;
+  else if (LackeyTrace::has_signature(data.get(), check_count))
+    return TraceFileType::Lackey;
+  else if (std::memchr(data.get(), '\0', check_count) != NULL)
     return TraceFileType::Binary;
   else
     return TraceFileType::Text;
 }
+
+bool is_live_input(const std::string& fname) {
+  if (fname == "-" || ShmRing::is_ring_name(fname)) return true;
+
+  struct stat st;
+  return stat(fname.c_str(), &st) == 0 && S_ISFIFO(st.st_mode);
+}
+
+bool parse_text_line(std::string_view line, MemoryRequest& request) {
+  uint64_t seq;
+  return parse_text_line(line, request, seq);
+}
+
+bool parse_text_line(std::string_view line, MemoryRequest& request, uint64_t& seq) {
+  const char* pos       = line.data();
+  const char* const end = pos + line.size();
+  if (skip_separators(pos, end) == end) return false;
+
+#ifdef DEBUG
+  std::cout << "Line: " << line << "\n";
+#endif
+
+  uint64_t address, pc;
+  int tid, size, bundle_kind, is_write;
+  try {
+    pos = parse_field(pos, end, seq, 10);
+    pos = parse_field(pos, end, tid, 10);
+    pos = parse_field(pos, end, bundle_kind, 10);
+    pos = parse_field(pos, end, is_write, 10);
+    pos = parse_field(pos, end, size, 10);
+    pos = parse_field(pos, end, address, 16);
+    pos = parse_field(pos, end, pc, 16);
+  } catch (const std::invalid_argument& e) {
+    throw std::invalid_argument("Malformed trace line: " + std::string(line));
+  }
+
+#ifdef DEBUG
+  std::cout << "Values: " << seq << " " << tid << " " << bundle_kind << " " << is_write
+            << " " << size << " " << address << " " << pc << "\n";
+#endif
+
+  if (!MemoryRequest::fits(tid, size, bundle_kind))
+    throw std::out_of_range("Trace line does not fit the packed trace representation: " +
+                            std::string(line));
+
+  request = MemoryRequest { tid, size, bundle_kind, is_write != 0, address, pc };
+  return true;
+}
 }  // namespace MemoryTraceTools
 
 
-MemoryTrace::MemoryTrace(std::istream& tracefile, TraceFileType ftype) {
+MemoryTrace::MemoryTrace(std::istream& tracefile, TraceFileType ftype,
+                         const TraceFilter& filter)
+    : filter(filter) {
   switch (ftype) {
     case TraceFileType::Text:
       construct_from_text_(tracefile);
@@ -53,173 +185,401 @@ MemoryTrace::MemoryTrace(std::istream& tracefile, TraceFileType ftype) {
     case TraceFileType::Binary:
       construct_from_binary_serial_(tracefile);
       break;
+    case TraceFileType::Compressed:
+      construct_from_compressed_serial_(tracefile);
+      break;
+    case TraceFileType::Lackey:
+      construct_from_foreign_(LackeyTrace::Reader { tracefile }, 0, SIZE_MAX);
+      break;
+    case TraceFileType::DrCacheSim:
+      construct_from_foreign_(DrCacheSimTrace::Reader { tracefile }, 0, SIZE_MAX);
+      break;
     default:
       throw std::invalid_argument("Unknown trace file type");
   }
 }
 
-MemoryTrace::MemoryTrace(std::istream&& tracefile, TraceFileType ftype)
-    : MemoryTrace(tracefile, ftype) { }
+MemoryTrace::MemoryTrace(std::istream&& tracefile, TraceFileType ftype,
+                         const TraceFilter& filter)
+    : MemoryTrace(tracefile, ftype, filter) { }
 
 MemoryTrace::MemoryTrace(const std::string& trace_fname, TraceFileType ftype,
-                         int io_threads) {
+                         int io_threads, size_t first, size_t count,
+                         const TraceFilter& filter)
+    : filter(filter) {
   switch (ftype) {
     case TraceFileType::Text:
-      construct_from_text_(trace_fname);
+      construct_from_text_(trace_fname, io_threads, first, count);
       break;
     case TraceFileType::Binary:
-      construct_from_binary_parallel_(trace_fname, io_threads);
+      construct_from_binary_parallel_(trace_fname, io_threads, first, count);
+      break;
+    case TraceFileType::Compressed:
+      construct_from_compressed_parallel_(trace_fname, io_threads, first, count);
       break;
+    case TraceFileType::Lackey:
+    case TraceFileType::DrCacheSim: {
+      std::ifstream tracefile { trace_fname, std::ios::binary };
+      if (!tracefile.is_open())
+        throw std::invalid_argument("Cannot open trace file: " + trace_fname);
+      if (ftype == TraceFileType::Lackey)
+        construct_from_foreign_(LackeyTrace::Reader { tracefile }, first, count);
+      else
+        construct_from_foreign_(DrCacheSimTrace::Reader { tracefile }, first, count);
+      break;
+    }
     default:
       throw std::invalid_argument("Unknown trace file type");
   }
 }
 
-const std::vector<MemoryRequest> MemoryTrace::getRequests() const { return requests; }
+RequestView MemoryTrace::getRequests() const { return { *this, 0, getLength() }; }
 
-const std::vector<uint64_t> MemoryTrace::getRequestAddresses() const {
-  if (requests.size() != requestAddresses.size()) {
-    assert(false && "This should never happen");
-  }
+Span<const uint64_t> MemoryTrace::getRequestAddresses() const { return addresses; }
 
-  return requestAddresses;
-}
+uint32_t MemoryTrace::pack_attributes_(const MemoryRequest& request) {
+  if (!MemoryRequest::fits(request.tid, request.size, request.bundle_kind))
+    throw std::out_of_range("Request does not fit the packed trace representation");
 
-void MemoryTrace::construct_from_text_(std::istream& tracefile) {
-  std::istringstream iss;
-
-  for (std::string line; std::getline(tracefile, line);) {
-    if (line.empty()) continue;
-
-    line.erase(std::remove(line.begin(), line.end(), ','), line.end());
-
-#ifdef DEBUG
-    std::cout << "Line: " << line << "\n";
-#endif
+  return static_cast<uint32_t>(request.tid) << 16 |
+         static_cast<uint32_t>(request.size) << 4 |
+         static_cast<uint32_t>(request.bundle_kind) << 1 |
+         static_cast<uint32_t>(request.is_write);
+}
 
-    iss.clear();
-    iss.str(line);
+uint32_t MemoryTrace::intern_pc_(uint64_t pc) {
+  const auto [it, inserted] = pc_index.try_emplace(pc, pcs.size());
+  if (inserted) pcs.push_back(pc);
+  return it->second;
+}
 
-    int seq, tid, size, bundle_kind;
-    bool is_write;
-    uint64_t address, pc;
-    iss >> std::dec >> seq >> tid >> bundle_kind >> is_write >> size;
-    iss >> std::hex >> address >> pc;
+void MemoryTrace::append_(const MemoryRequest& request) {
+  if (!filter.accepts(request)) return;
 
-#ifdef DEBUG
-    std::cout << "Values: " << seq << " " << tid << " " << bundle_kind << " " << is_write
-              << " " << size << " " << address << " " << pc << "\n";
-#endif
+  attributes.push_back(pack_attributes_(request));
+  addresses.push_back(request.address);
+  pc_ids.push_back(intern_pc_(request.pc));
+  summariser.add(request);
+}
 
-    requests.emplace_back(tid, size, bundle_kind, is_write, address, pc);
-    requestAddresses.push_back(address);
-  }
+void MemoryTrace::construct_from_text_(std::istream& tracefile) {
+  MemoryRequest request;
+  for (std::string line; std::getline(tracefile, line);)
+    if (MemoryTraceTools::parse_text_line(line, request)) append_(request);
 }
 
-void MemoryTrace::construct_from_text_(const std::string& trace_fname) {
-  std::ifstream tracefile { trace_fname };
-  construct_from_text_(tracefile);
+void MemoryTrace::construct_from_text_(const std::string& trace_fname, int io_threads,
+                                       size_t first, size_t count) {
+  const MappedFile tracefile { trace_fname };
+  tracefile.advise(MADV_SEQUENTIAL);
+
+  const char* const data = tracefile.data();
+  const size_t bytes     = tracefile.size();
+
+  // Split the file into one chunk per thread, with every chunk ending on a newline.
+  // Chunks should be large enough to be worth a thread
+  const size_t min_chunk_bytes { 1 << 20 };
+  const size_t nchunks = std::max<size_t>(
+      1, std::min(thread_count_(io_threads), bytes / min_chunk_bytes));
+
+  std::vector<const char*> chunk_starts { data };
+  for (size_t c = 1; c < nchunks; c++) {
+    const char* start = std::max(chunk_starts.back(), data + bytes / nchunks * c);
+    start             = std::min(line_end(start, data + bytes) + 1, data + bytes);
+    chunk_starts.push_back(start);
+  }
+  chunk_starts.push_back(data + bytes);
+
+  // Count the requests in each chunk, so that they can be parsed straight into place
+  std::vector<size_t> bounds(nchunks + 1, 0);
+  run_threads_(nchunks, [&](size_t chunk) {
+    size_t count { 0 };
+    for (const char* pos = chunk_starts[chunk]; pos < chunk_starts[chunk + 1];) {
+      const char* eol = line_end(pos, chunk_starts[chunk + 1]);
+      if (skip_separators(pos, eol) != eol) count++;
+      pos = eol + 1;
+    }
+    bounds[chunk + 1] = count;
+  });
+  for (size_t c = 0; c < nchunks; c++) bounds[c + 1] += bounds[c];
+
+  // Only the lines in the window are parsed. The lines before it are just counted
+  const auto [wfirst, wlast] = clamp_window_(bounds.back(), first, count);
+  std::vector<size_t> window_bounds;
+  for (const auto bound : bounds)
+    window_bounds.push_back(std::clamp(bound, wfirst, wlast) - wfirst);
+
+  construct_parallel_(window_bounds, [&, wfirst = wfirst](size_t chunk, size_t lo,
+                                                          size_t hi, const auto& emit) {
+    MemoryRequest request;
+    const char* const end = chunk_starts[chunk + 1];
+    size_t i { bounds[chunk] };
+    for (const char* pos = chunk_starts[chunk]; pos < end && i < wfirst + hi;) {
+      const char* eol = line_end(pos, end);
+      if (i < wfirst + lo) {
+        if (skip_separators(pos, eol) != eol) i++;
+      } else if (MemoryTraceTools::parse_text_line(
+                     { pos, static_cast<size_t>(eol - pos) }, request)) {
+        emit(i++ - wfirst, request);
+      }
+      pos = eol + 1;
+    }
+  });
 }
 
 void MemoryTrace::construct_from_binary_serial_(std::istream& tracefile) {
+  // v1 traces start with the record count where newer ones have the magic number
+  BinaryTrace::Header header;
+  tracefile.read(reinterpret_cast<char*>(&header), BinaryTrace::LEGACY_HEADER_SIZE);
+
   size_t elements;
-  tracefile.read(reinterpret_cast<char*>(&elements), sizeof(size_t));
+  if (BinaryTrace::has_magic(header.magic, BinaryTrace::LEGACY_HEADER_SIZE)) {
+    tracefile.read(reinterpret_cast<char*>(&header) + BinaryTrace::LEGACY_HEADER_SIZE,
+                   sizeof(BinaryTrace::Header) - BinaryTrace::LEGACY_HEADER_SIZE);
+    BinaryTrace::check_header(header);
+    tracefile.ignore(header.header_size - sizeof(BinaryTrace::Header));
+    elements = header.summary.record_count;
+  } else {
+    std::memcpy(&elements, &header, sizeof(size_t));
+  }
 
-  requests.reserve(elements);
-  requestAddresses.reserve(elements);
+  // Filtered traces could be much shorter, so they grow as needed instead
+  if (filter.empty()) {
+    addresses.reserve(elements);
+    pc_ids.reserve(elements);
+    attributes.reserve(elements);
+  }
 
+  char record[BinaryTrace::RECORD_SIZE];
   for (size_t i = 0; i < elements; i++) {
-    int tid, size, bundle_kind;
-    bool is_write;
-    uint64_t address, pc;
-
-    tracefile.read(reinterpret_cast<char*>(&tid), sizeof(int));
-    tracefile.read(reinterpret_cast<char*>(&size), sizeof(int));
-    tracefile.read(reinterpret_cast<char*>(&bundle_kind), sizeof(int));
-    tracefile.read(reinterpret_cast<char*>(&is_write), sizeof(bool));
-    tracefile.read(reinterpret_cast<char*>(&address), sizeof(uint64_t));
-    tracefile.read(reinterpret_cast<char*>(&pc), sizeof(uint64_t));
-
-    requests.emplace_back(tid, size, bundle_kind, is_write, address, pc);
-    requestAddresses.push_back(address);
+    tracefile.read(record, BinaryTrace::RECORD_SIZE);
+    append_(BinaryTrace::decode(record));
   }
 }
 
-void MemoryTrace::construct_from_binary_parallel_(const std::string& trace_fname,
-                                                  int io_threads) {
-
-  std::ifstream tracefile { trace_fname, std::ios::binary };
-  size_t elements;
-  tracefile.read(reinterpret_cast<char*>(&elements), sizeof(size_t));
-  tracefile.close();
+std::pair<size_t, size_t> MemoryTrace::clamp_window_(size_t length, size_t first,
+                                                     size_t count) {
+  first = std::min(first, length);
+  return { first, first + std::min(count, length - first) };
+}
 
-  requests         = std::vector<MemoryRequest>(elements);
-  requestAddresses = std::vector<uint64_t>(elements);
+size_t MemoryTrace::thread_count_(int io_threads) {
+  return std::max(1u, std::min(static_cast<unsigned>(std::max(io_threads, 1)),
+                               std::thread::hardware_concurrency()));
+}
 
-  const size_t max_threads =
-      std::min(static_cast<unsigned>(io_threads), std::thread::hardware_concurrency());
-  const auto nthreads              = std::min(elements, max_threads);
-  const size_t elements_per_thread = std::ceil(elements / static_cast<double>(nthreads));
-  const size_t bytes_per_thread =
-      elements_per_thread * (3 * sizeof(int) + sizeof(bool) + 2 * sizeof(uint64_t));
+std::vector<size_t> MemoryTrace::split_ranges_(size_t elements, int io_threads,
+                                               size_t granularity) {
+  const size_t units    = (elements + granularity - 1) / granularity;
+  const size_t nthreads = std::max<size_t>(1, std::min(units, thread_count_(io_threads)));
+  const size_t elements_per_thread = (units + nthreads - 1) / nthreads * granularity;
+
+  std::vector<size_t> bounds;
+  for (size_t t = 0; t < nthreads; t++)
+    bounds.push_back(std::min(t * elements_per_thread, elements));
+  bounds.push_back(elements);
+  return bounds;
+}
 
+template <typename Body>
+void MemoryTrace::run_threads_(size_t nthreads, const Body& body) {
   std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(nthreads);
   threads.reserve(nthreads);
 
   for (size_t thread_num = 0; thread_num < nthreads; thread_num++) {
     threads.emplace_back([&, thread_num]() {
-      std::ifstream tracefile { trace_fname, std::ios::binary };
-      const size_t file_offset = sizeof(size_t) + bytes_per_thread * thread_num;
-
-      tracefile.seekg(file_offset);
-
-      for (size_t i = 0;
-           i < elements_per_thread && i + elements_per_thread * thread_num < elements;
-           i++) {
-        const size_t global_element = elements_per_thread * thread_num + i;
-
-        uint64_t address;
-
-        tracefile.read(reinterpret_cast<char*>(&requests[global_element].tid),
-                       sizeof(int));
-        tracefile.read(reinterpret_cast<char*>(&requests[global_element].size),
-                       sizeof(int));
-        tracefile.read(reinterpret_cast<char*>(&requests[global_element].bundle_kind),
-                       sizeof(int));
-        tracefile.read(reinterpret_cast<char*>(&requests[global_element].is_write),
-                       sizeof(bool));
-        tracefile.read(reinterpret_cast<char*>(&address), sizeof(uint64_t));
-        tracefile.read(reinterpret_cast<char*>(&requests[global_element].pc),
-                       sizeof(uint64_t));
-
-        requests[global_element].address = address;
-        requestAddresses[global_element] = address;
+      try {
+        body(thread_num);
+      } catch (...) {
+        errors[thread_num] = std::current_exception();
       }
     });
   }
 
   for (auto& t : threads) t.join();
+  for (const auto& e : errors)
+    if (e) std::rethrow_exception(e);
+}
+
+template <typename RangeDecoder>
+void MemoryTrace::construct_parallel_(const std::vector<size_t>& bounds,
+                                      const RangeDecoder& decode_range) {
+  const size_t nthreads = bounds.size() - 1;
+
+  // Unfiltered requests are decoded straight into place. Filtered ones are collected per
+  // thread, so that only the accepted requests are ever stored, and merged afterwards
+  const bool filtered = !filter.empty();
+  if (!filtered) {
+    addresses.resize(bounds.back());
+    pc_ids.resize(bounds.back());
+    attributes.resize(bounds.back());
+    if (bounds.back() == 0) return;
+  }
+  std::vector<LocalColumns> local(filtered ? nthreads : 0);
+
+  // Each thread builds a PC dictionary and a summary for its own range, which are merged
+  // afterwards
+  std::vector<std::vector<uint64_t>> thread_pcs(nthreads);
+  std::vector<TraceSummariser> thread_summarisers(nthreads);
+
+  run_threads_(nthreads, [&](size_t thread_num) {
+    std::unordered_map<uint64_t, uint32_t> local_index;
+    auto& local_pcs = thread_pcs[thread_num];
+
+    const auto local_pc_id = [&](uint64_t pc) {
+      const auto [it, inserted] = local_index.try_emplace(pc, local_pcs.size());
+      if (inserted) local_pcs.push_back(pc);
+      return it->second;
+    };
+
+    auto& local_summariser = thread_summarisers[thread_num];
+
+    decode_range(thread_num, bounds[thread_num], bounds[thread_num + 1],
+                 [&](size_t i, const MemoryRequest& request) {
+                   if (!filtered) {
+                     addresses[i]  = request.address;
+                     attributes[i] = pack_attributes_(request);
+                     pc_ids[i]     = local_pc_id(request.pc);
+                     local_summariser.add(request);
+                   } else if (filter.accepts(request)) {
+                     auto& columns = local[thread_num];
+                     columns.addresses.push_back(request.address);
+                     columns.attributes.push_back(pack_attributes_(request));
+                     columns.pc_ids.push_back(local_pc_id(request.pc));
+                     local_summariser.add(request);
+                   }
+                 });
+  });
+  for (const auto& local_summariser : thread_summarisers)
+    summariser.merge(local_summariser);
+
+  // Filtered threads' requests end up one after the other, in order
+  std::vector<size_t> out_bounds { bounds };
+  if (filtered) {
+    for (size_t thread_num = 0; thread_num < nthreads; thread_num++)
+      out_bounds[thread_num + 1] =
+          out_bounds[thread_num] + local[thread_num].addresses.size();
+
+    addresses.resize(out_bounds.back());
+    pc_ids.resize(out_bounds.back());
+    attributes.resize(out_bounds.back());
+  }
+
+  // Map the thread-local PC indices to the global dictionary
+  std::vector<std::vector<uint32_t>> remap(nthreads);
+  for (size_t thread_num = 0; thread_num < nthreads; thread_num++)
+    for (const auto pc : thread_pcs[thread_num])
+      remap[thread_num].push_back(intern_pc_(pc));
+
+  run_threads_(nthreads, [&](size_t thread_num) {
+    const size_t first = out_bounds[thread_num], last = out_bounds[thread_num + 1];
+    if (!filtered) {
+      for (size_t i = first; i < last; i++) pc_ids[i] = remap[thread_num][pc_ids[i]];
+      return;
+    }
+
+    auto& columns = local[thread_num];
+    std::copy(columns.addresses.begin(), columns.addresses.end(),
+              addresses.begin() + first);
+    std::copy(columns.attributes.begin(), columns.attributes.end(),
+              attributes.begin() + first);
+    for (size_t i = first; i < last; i++)
+      pc_ids[i] = remap[thread_num][columns.pc_ids[i - first]];
+    columns = LocalColumns {};
+  });
+}
+
+void MemoryTrace::construct_from_binary_parallel_(const std::string& trace_fname,
+                                                  int io_threads, size_t first,
+                                                  size_t count) {
+  const MappedBinaryTrace tracefile { trace_fname };
+  const auto [wfirst, wlast] = clamp_window_(tracefile.size(), first, count);
+
+  // Records are fixed-size, so the window is read in place without touching the rest
+  construct_parallel_(
+      split_ranges_(wlast - wfirst, io_threads, 1),
+      [&, wfirst = wfirst](size_t, size_t lo, size_t hi, const auto& emit) {
+        if (lo == hi) return;
+        tracefile.willneed(wfirst + lo, hi - lo);
+        for (size_t i = lo; i < hi; i++) emit(i, tracefile[wfirst + i]);
+      });
+}
+
+void MemoryTrace::construct_from_compressed_(const CompressedTrace::Decoder& decoder,
+                                             int io_threads, size_t first, size_t count) {
+  const auto [wfirst, wlast] = clamp_window_(decoder.size(), first, count);
+
+  // Threads are given whole blocks where possible, since blocks can only be decoded as a
+  // unit. Only the blocks overlapping the window are decoded
+  construct_parallel_(
+      split_ranges_(wlast - wfirst, io_threads, decoder.block_size()),
+      [&, wfirst = wfirst](size_t, size_t lo, size_t hi, const auto& emit) {
+        if (lo == hi) return;
+
+        std::vector<MemoryRequest> block(decoder.block_size());
+        for (auto b = decoder.find_block(wfirst + lo); b < decoder.nblocks(); b++) {
+          const size_t block_first = decoder.block_first(b);
+          if (block_first >= wfirst + hi) break;
+
+          const size_t n = decoder.decode_block(b, block.data());
+          for (size_t i = 0; i < n; i++)
+            if (block_first + i >= wfirst + lo && block_first + i < wfirst + hi)
+              emit(block_first + i - wfirst, block[i]);
+        }
+      });
+}
+
+void MemoryTrace::construct_from_compressed_serial_(std::istream& tracefile) {
+  const std::string data { std::istreambuf_iterator<char>(tracefile),
+                           std::istreambuf_iterator<char>() };
+  construct_from_compressed_({ data.data(), data.size() }, 1, 0, SIZE_MAX);
+}
+
+void MemoryTrace::construct_from_compressed_parallel_(const std::string& trace_fname,
+                                                      int io_threads, size_t first,
+                                                      size_t count) {
+  const MappedCompressedTrace tracefile { trace_fname };
+  construct_from_compressed_(tracefile.getDecoder(), io_threads, first, count);
+}
+
+template <typename Reader>
+void MemoryTrace::construct_from_foreign_(Reader&& reader, size_t first, size_t count) {
+  std::vector<MemoryRequest> chunk(1 << 12);
+  size_t position { 0 };
+  while (count > 0) {
+    const size_t n = reader.read(chunk.data(), chunk.size());
+    if (n == 0) break;
+
+    // Requests before the window still have to be decoded, for the state they leave
+    const size_t start = std::min(n, first - std::min(first, position));
+    const size_t end   = start + std::min(count, n - start);
+    for (size_t i = start; i < end; i++) append_(chunk[i]);
+
+    position += n;
+    count -= end - start;
+  }
 }
 
 
 size_t MemoryTrace::getLength() const {
-  assert(requests.size() == requestAddresses.size());
-  return requests.size();
+  assert(addresses.size() == pc_ids.size() && addresses.size() == attributes.size());
+  return addresses.size();
 }
 
+size_t MemoryTrace::getUniquePCs() const { return pcs.size(); }
+
+TraceSummary MemoryTrace::getSummary() const { return summariser.get(); }
+
 
 void MemoryTrace::write_binary(const std::string& fname) const {
-  std::ofstream f { fname };
-
-  const size_t length = getLength();
-  f.write(reinterpret_cast<const char*>(&length), sizeof(size_t));
-
-  for (const auto& request : requests) {
-    f.write(reinterpret_cast<const char*>(&request.tid), sizeof(int));
-    f.write(reinterpret_cast<const char*>(&request.size), sizeof(int));
-    f.write(reinterpret_cast<const char*>(&request.bundle_kind), sizeof(int));
-    f.write(reinterpret_cast<const char*>(&request.is_write), sizeof(bool));
-    f.write(reinterpret_cast<const char*>(&request.address), sizeof(uint64_t));
-    f.write(reinterpret_cast<const char*>(&request.pc), sizeof(uint64_t));
-  }
+  BinaryTrace::Writer writer { fname };
+  for (const auto& request : getRequests()) writer.write(request);
+  writer.finish();
+}
+
+void MemoryTrace::write_compressed(const std::string& fname, uint32_t block_size) const {
+  CompressedTrace::Writer writer { fname, block_size };
+  for (const auto& request : getRequests()) writer.write(request);
+  writer.finish();
 }
@@ -1,19 +1,44 @@
 #pragma once
 
+#include <cstdint>
 #include <fstream>
+#include <iterator>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include "HyperLogLog.hh"
+#include "Span.hh"
+
 #define DEFAULT_IO_THREADS 12
+#define DEFAULT_COMPRESSED_BLOCK_SIZE (1 << 16)
 
+/* A single memory access. Fields are narrowed so that a request takes 24 bytes */
 struct MemoryRequest {
-  int tid, size, bundle_kind;
-  bool is_write;
   uint64_t address, pc;
+  uint16_t tid, size;
+  uint8_t bundle_kind;
+  bool is_write;
+
+  /* The largest values the packed representation of a trace can hold (see
+   * `MemoryTrace`) */
+  static constexpr int64_t MAX_TID = 0xffff, MAX_SIZE = 0xfff, MAX_BUNDLE_KIND = 0x7;
 
   MemoryRequest() = default;
+
+  /* The fields are narrowed without checking, so whatever reads them from a trace must
+   * check them with `fits` first */
   explicit MemoryRequest(const int tid, const int size, const int bundle_value,
                          const bool is_write, const uint64_t address, const uint64_t pc);
 
+  /* Whether a request with these fields fits the packed representation of a trace */
+  static bool fits(const int64_t tid, const int64_t size, const int64_t bundle_kind) {
+    return tid >= 0 && tid <= MAX_TID && size >= 0 && size <= MAX_SIZE &&
+           bundle_kind >= 0 && bundle_kind <= MAX_BUNDLE_KIND;
+  }
+
   bool is_bundle() const;
   bool is_bundle_start() const;
   bool is_bundle_middle() const;
@@ -21,7 +46,7 @@ struct MemoryRequest {
 
   friend std::ostream& operator<<(std::ostream& stream, const MemoryRequest& req) {
     stream << "Request{"
-           << "tid: " << req.tid << ", bundle_kind: " << req.bundle_kind
+           << "tid: " << req.tid << ", bundle_kind: " << static_cast<int>(req.bundle_kind)
            << ", is_write: " << req.is_write << ", size: " << req.size << ", address: 0x"
            << std::hex << req.address << ", pc: 0x" << req.pc << "}" << std::dec;
     return stream;
@@ -29,41 +54,297 @@ struct MemoryRequest {
 };
 
 
-enum class TraceFileType { Text, Binary };
+/* A run of consecutive requests that all fall within the same cache line, collapsed into
+ * one weighted record. Non-bundle requests are grouped together, and bundle requests are
+ * only grouped with others from the same PC */
+struct RequestRun {
+  /* The first request in the run */
+  MemoryRequest request;
+
+  /* The number of requests in the run, and how many of them start a bundle */
+  uint32_t count { 1 }, bundle_starts { 0 };
+
+  /* The total size of all the requests in the run */
+  uint64_t bytes { 0 };
+};
+
+/* Summary statistics of a trace. Binary traces store these in their header, so that they
+ * are available without a pass over the trace. The distinct address and line counts are
+ * estimates (see `HyperLogLog`) */
+struct TraceSummary {
+  uint64_t record_count { 0 };
+  uint64_t unique_addresses { 0 }, unique_lines_64 { 0 }, unique_lines_256 { 0 };
+  uint64_t bundle_count { 0 };
+  uint64_t min_address { UINT64_MAX }, max_address { 0 };
+};
+
+/* Builds a `TraceSummary` one request at a time, in constant memory. Summarisers of
+ * different parts of a trace can be merged into the summariser of the whole */
+class TraceSummariser {
+  TraceSummary summary;
+  HyperLogLog addresses, lines_64, lines_256;
+
+ public:
+  void add(const MemoryRequest& request);
+  void merge(const TraceSummariser& other);
+  TraceSummary get() const;
+};
+
+
+/* A predicate on requests. Traces apply it as they are read, so rejected requests are
+ * never stored. A default-constructed filter accepts every request */
+struct TraceFilter {
+  std::optional<int> tid;
+  std::optional<bool> is_write;
+
+  /* Inclusive ranges of accepted PCs and addresses */
+  uint64_t pc_min { 0 }, pc_max { UINT64_MAX };
+  uint64_t address_min { 0 }, address_max { UINT64_MAX };
+
+  /* A mask of the accepted bundle kinds, where bit k accepts `bundle_kind` k */
+  uint8_t bundle_kinds { 0xff };
+
+  /* Whether this filter accepts every request */
+  bool empty() const;
+
+  bool accepts(const MemoryRequest& request) const {
+    return (!tid || request.tid == *tid) &&
+           (!is_write || request.is_write == *is_write) && request.pc >= pc_min &&
+           request.pc <= pc_max &&
+           request.address >= address_min && request.address <= address_max &&
+           (bundle_kinds >> request.bundle_kind & 0x1);
+  }
+};
+
+
+/* ArmIE text and the simulator's own binary formats, and the formats of other tools that
+ * are imported as they are read (see `ForeignTrace.hh`) */
+enum class TraceFileType { Text, Binary, Compressed, Lackey, DrCacheSim };
 
 namespace MemoryTraceTools {
 TraceFileType guess_file_type(const std::string& fname);
+
+/* Check whether the given trace is read live: `-` for stdin, a named pipe, or a shared
+ * memory ring (see `ShmRing`). Live traces can only be read once, front to back */
+bool is_live_input(const std::string& fname);
+
+/* Collapse the requests in [first, last) into runs of requests to the same `line_size`
+ * byte line, appended to `runs`. Requests that cross a line boundary are never grouped */
+template <typename Iterator>
+void compact_runs(Iterator first, Iterator last, int line_size,
+                  std::vector<RequestRun>& runs) {
+  // The line of the current run, or -1 if the run cannot be extended
+  int64_t run_line { -1 };
+
+  for (; first != last; ++first) {
+    const MemoryRequest request = *first;
+
+    const uint64_t line = request.address / line_size;
+    const bool in_line =
+        request.size != 0 && (request.address + request.size - 1) / line_size == line;
+
+    if (in_line && run_line == static_cast<int64_t>(line)) {
+      RequestRun& run = runs.back();
+      if (run.count < UINT32_MAX && request.is_bundle() == run.request.is_bundle() &&
+          (!request.is_bundle() || request.pc == run.request.pc)) {
+        run.count++;
+        run.bundle_starts += request.is_bundle_start();
+        run.bytes += request.size;
+        continue;
+      }
+    }
+
+    runs.push_back({ request, 1, request.is_bundle_start(), request.size });
+    run_line = in_line ? static_cast<int64_t>(line) : -1;
+  }
+}
+
+/* Parse a single line of a text trace into `request`. Returns false if the line is blank
+ * and holds no request. Throws if the line is malformed */
+bool parse_text_line(std::string_view line, MemoryRequest& request);
+
+/* As above, also returning the request's sequence number */
+bool parse_text_line(std::string_view line, MemoryRequest& request, uint64_t& seq);
 }  // namespace MemoryTraceTools
 
-/* Represents an ArmIE memory trace */
+class RequestView;
+
+namespace CompressedTrace {
+class Decoder;
+}  // namespace CompressedTrace
+
+/* Represents an ArmIE memory trace.
+ * Requests are stored as columns of 16 bytes per request in total: the address, an index
+ * into a dictionary of the (heavily repeated) PCs, and the remaining fields packed into
+ * 32 bits */
 class MemoryTrace {
-  std::vector<MemoryRequest> requests;
-  std::vector<uint64_t> requestAddresses;
+  std::vector<uint64_t> addresses;
+  std::vector<uint32_t> pc_ids;
+  std::vector<uint32_t> attributes;
+
+  /* The dictionary of unique PCs, and the reverse mapping used to build it */
+  std::vector<uint64_t> pcs;
+  std::unordered_map<uint64_t, uint32_t> pc_index;
+
+  /* Only requests accepted by this filter are stored */
+  const TraceFilter filter;
+
+  /* Summarises the stored requests as they are loaded */
+  TraceSummariser summariser;
+
+  /* The requests a single thread decodes, before they are merged into the trace */
+  struct LocalColumns {
+    std::vector<uint64_t> addresses;
+    std::vector<uint32_t> pc_ids, attributes;
+  };
+
+  /* Pack a request's tid, size, bundle_kind, and is_write fields into 32 bits.
+   * Throws if a field is too wide for the packed representation */
+  static uint32_t pack_attributes_(const MemoryRequest& request);
+
+  uint32_t intern_pc_(uint64_t pc);
+  void append_(const MemoryRequest& request);
 
+  /* Constructors from file names only load the window of `count` requests starting at
+   * request `first` */
   inline void construct_from_text_(std::istream& tracefile);
-  inline void construct_from_text_(const std::string& trace_fname);
+  inline void construct_from_text_(const std::string& trace_fname, int io_threads,
+                                   size_t first, size_t count);
   inline void construct_from_binary_serial_(std::istream& tracefile);
   inline void construct_from_binary_parallel_(const std::string& trace_fname,
-                                              int io_threads);
+                                              int io_threads, size_t first, size_t count);
+  inline void construct_from_compressed_(const CompressedTrace::Decoder& decoder,
+                                         int io_threads, size_t first, size_t count);
+  inline void construct_from_compressed_serial_(std::istream& tracefile);
+  inline void construct_from_compressed_parallel_(const std::string& trace_fname,
+                                                  int io_threads, size_t first,
+                                                  size_t count);
+
+  /* Imported formats are decoded in order, since each request depends on the records
+   * before it */
+  template <typename Reader>
+  void construct_from_foreign_(Reader&& reader, size_t first, size_t count);
+
+  /* Clamp the window of `count` requests starting at `first` to a trace of `length`
+   * requests, returning the window's [first, last) */
+  static std::pair<size_t, size_t> clamp_window_(size_t length, size_t first,
+                                                 size_t count);
+
+  /* The number of threads to use for I/O, capped by the number of CPUs */
+  static size_t thread_count_(int io_threads);
+
+  /* Split `elements` requests into one range per thread, as a list of range bounds. Each
+   * range is a multiple of `granularity` requests, except the last */
+  static std::vector<size_t> split_ranges_(size_t elements, int io_threads,
+                                           size_t granularity);
+
+  /* Run `body(thread_num)` on `nthreads` threads, rethrowing the first error raised */
+  template <typename Body>
+  static void run_threads_(size_t nthreads, const Body& body);
+
+  /* Fill in requests using one thread per range, where range t is [bounds[t],
+   * bounds[t + 1]). `decode_range(t, first, last, emit)` must call `emit(i, request)`
+   * for every i in range t, in order. Requests rejected by the filter are dropped */
+  template <typename RangeDecoder>
+  void construct_parallel_(const std::vector<size_t>& bounds,
+                           const RangeDecoder& decode_range);
 
  public:
   /* Construct a MemoryTrace object from a trace file.
      Binary traces are read sequentially */
   explicit MemoryTrace(std::istream& tracefile,
-                       TraceFileType ftype = TraceFileType::Text);
+                       TraceFileType ftype       = TraceFileType::Text,
+                       const TraceFilter& filter = {});
   explicit MemoryTrace(std::istream&& tracefile,
-                       TraceFileType ftype = TraceFileType::Text);
+                       TraceFileType ftype       = TraceFileType::Text,
+                       const TraceFilter& filter = {});
 
   /* Construct a MemoryTrace object from a trace file name
-     Binary traces are read in parallel */
+     Traces are read in parallel. Only the `count` requests starting at request `first`
+     are loaded, and requests outside this window are never decoded */
   explicit MemoryTrace(const std::string& trace_fname,
                        TraceFileType ftype = TraceFileType::Text,
-                       int io_threads      = DEFAULT_IO_THREADS);
+                       int io_threads = DEFAULT_IO_THREADS, size_t first = 0,
+                       size_t count = SIZE_MAX, const TraceFilter& filter = {});
+
+  /* Decode the i-th request in this trace */
+  MemoryRequest getRequest(size_t i) const {
+    const uint32_t attrs = attributes[i];
+    return MemoryRequest { static_cast<int>(attrs >> 16),          // tid
+                           static_cast<int>((attrs >> 4) & 0xfff),  // size
+                           static_cast<int>((attrs >> 1) & 0x7),    // bundle_kind
+                           static_cast<bool>(attrs & 0x1),          // is_write
+                           addresses[i], pcs[pc_ids[i]] };
+  }
 
-  const std::vector<MemoryRequest> getRequests() const;
-  const std::vector<uint64_t> getRequestAddresses() const;
+  /* Views of the requests in this trace, and of their addresses. The views are only
+   * valid for as long as this trace is */
+  RequestView getRequests() const;
+  Span<const uint64_t> getRequestAddresses() const;
   size_t getLength() const;
 
+  /* The number of distinct PCs in this trace */
+  size_t getUniquePCs() const;
+
+  /* The summary statistics of this trace, gathered while it was loaded */
+  TraceSummary getSummary() const;
+
   /* Save this trace to a binary file */
   void write_binary(const std::string& fname) const;
+
+  /* Save this trace to a compressed, block-indexed binary file */
+  void write_compressed(const std::string& fname,
+                        uint32_t block_size = DEFAULT_COMPRESSED_BLOCK_SIZE) const;
+};
+
+/* A read-only view of a range of requests in a `MemoryTrace`, decoded on access */
+class RequestView {
+  const MemoryTrace* trace;
+  size_t first, count;
+
+ public:
+  RequestView(const MemoryTrace& trace, size_t first, size_t count)
+      : trace(&trace), first(first), count(count) { }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  MemoryRequest operator[](size_t i) const { return trace->getRequest(first + i); }
+
+  /* A view of `n` requests starting at `offset`, clamped to the end of this view */
+  RequestView subspan(size_t offset, size_t n = static_cast<size_t>(-1)) const {
+    if (offset > count) offset = count;
+    if (n > count - offset) n = count - offset;
+    return RequestView { *trace, first + offset, n };
+  }
+
+  class const_iterator {
+    const MemoryTrace* trace;
+    size_t i;
+
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type        = MemoryRequest;
+    using difference_type   = std::ptrdiff_t;
+    using pointer           = const MemoryRequest*;
+    using reference         = MemoryRequest;
+
+    const_iterator(const MemoryTrace* trace, size_t i) : trace(trace), i(i) { }
+
+    MemoryRequest operator*() const { return trace->getRequest(i); }
+    const_iterator& operator++() {
+      i++;
+      return *this;
+    }
+    const_iterator operator++(int) {
+      auto old = *this;
+      i++;
+      return old;
+    }
+    bool operator==(const const_iterator& other) const { return i == other.i; }
+    bool operator!=(const const_iterator& other) const { return i != other.i; }
+  };
+
+  const_iterator begin() const { return { trace, first }; }
+  const_iterator end() const { return { trace, first + count }; }
 };
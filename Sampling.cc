@@ -0,0 +1,129 @@
+#include "Sampling.hh"
+
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+/* The two-sided 95% critical values of Student's t distribution, by degrees of freedom.
+ * Past the end of the table, the normal approximation is close enough */
+const double T_CRITICAL_95[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                 2.262,  2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                 2.110,  2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                 2.060,  2.056, 2.052, 2.048, 2.045, 2.042 };
+
+double t_critical_95(size_t degrees_of_freedom) {
+  const size_t table_size = sizeof(T_CRITICAL_95) / sizeof(T_CRITICAL_95[0]);
+  return degrees_of_freedom <= table_size ? T_CRITICAL_95[degrees_of_freedom - 1] : 1.96;
+}
+}  // namespace
+
+SampleSchedule::SampleSchedule(const SamplingConfig& config)
+    : config(config), rng(config.seed) {
+  if (!config.enabled()) throw std::invalid_argument("Sampling is not enabled");
+  if (config.sample_size == 0 || config.sample_size > config.period)
+    throw std::invalid_argument("Samples must be non-empty and fit in their period");
+}
+
+SampleInterval SampleSchedule::next() {
+  const uint64_t slack = config.period - config.sample_size;
+
+  uint64_t offset { slack };
+  if (config.mode == SamplingMode::Random)
+    offset = std::uniform_int_distribution<uint64_t> { 0, slack }(rng);
+
+  const uint64_t gap = carry + offset;
+  carry              = slack - offset;
+
+  const uint64_t warm = std::min(gap, config.warming);
+  return { gap - warm, warm, config.sample_size };
+}
+
+// ------
+
+void SampleStats::add(const std::vector<uint64_t>& accesses,
+                      const std::vector<uint64_t>& misses) {
+  samples.resize(accesses.size());
+  for (size_t level = 0; level < accesses.size(); level++)
+    samples[level].emplace_back(accesses[level], misses[level]);
+}
+
+size_t SampleStats::size() const { return samples.empty() ? 0 : samples[0].size(); }
+
+std::pair<double, double> SampleStats::getMissRate(int level) const {
+  std::vector<double> rates;
+  for (const auto& [accesses, misses] : samples.at(level - 1))
+    if (accesses > 0) rates.push_back(static_cast<double>(misses) / accesses);
+
+  if (rates.empty()) return { 0, 1.0 };
+
+  double mean { 0 };
+  for (const double rate : rates) mean += rate;
+  mean /= rates.size();
+
+  if (rates.size() < 2) return { mean, 1.0 };
+
+  double variance { 0 };
+  for (const double rate : rates) variance += (rate - mean) * (rate - mean);
+  variance /= rates.size() - 1;
+
+  const double std_error = std::sqrt(variance / rates.size());
+  return { mean, t_critical_95(rates.size() - 1) * std_error };
+}
+
+// ------
+
+Sampler::Sampler(const SamplingConfig& config, bool input_skipped)
+    : schedule(config), interval(schedule.next()), input_skipped(input_skipped) {
+  remaining = input_skipped ? 0 : interval.skip;
+}
+
+void Sampler::next_phase_(CacheHierarchy& cache) {
+  switch (phase) {
+    case Phase::Skip:
+      phase     = Phase::Warm;
+      remaining = interval.warm;
+      if (remaining > 0) cache.pause_stats();
+      break;
+
+    case Phase::Warm:
+      cache.resume_stats();
+      phase     = Phase::Measure;
+      remaining = interval.measure;
+
+      start_accesses.resize(cache.nlevels());
+      start_misses.resize(cache.nlevels());
+      for (int level = 1; level <= cache.nlevels(); level++) {
+        start_accesses[level - 1] = cache.getTotalAccesses(level);
+        start_misses[level - 1]   = cache.getMisses(level);
+      }
+      break;
+
+    case Phase::Measure:
+      record_sample_(cache);
+      interval  = schedule.next();
+      phase     = Phase::Skip;
+      remaining = input_skipped ? 0 : interval.skip;
+      break;
+  }
+}
+
+void Sampler::record_sample_(const CacheHierarchy& cache) {
+  std::vector<uint64_t> accesses(cache.nlevels()), misses(cache.nlevels());
+  for (int level = 1; level <= cache.nlevels(); level++) {
+    accesses[level - 1] = cache.getTotalAccesses(level) - start_accesses[level - 1];
+    misses[level - 1]   = cache.getMisses(level) - start_misses[level - 1];
+  }
+  stats.add(accesses, misses);
+}
+
+void Sampler::finish(CacheHierarchy& cache) {
+  if (phase == Phase::Warm) cache.resume_stats();
+
+  // A sample cut short by the end of the trace is still a sample, only a smaller one
+  if (phase == Phase::Measure && remaining < interval.measure) record_sample_(cache);
+  phase = Phase::Skip;
+}
+
+uint64_t Sampler::getMeasured() const { return measured; }
+
+const SampleStats& Sampler::getStats() const { return stats; }
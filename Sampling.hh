@@ -0,0 +1,128 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "CacheHierarchy.hh"
+
+enum class SamplingMode { None, Periodic, Random };
+
+/* How to sample a trace. Every `period` requests, a sample of `sample_size` consecutive
+ * requests is simulated and counted in the results. Periodic sampling takes the last
+ * requests of each period, and random sampling takes them from a random position in it */
+struct SamplingConfig {
+  SamplingMode mode { SamplingMode::None };
+  uint64_t period { 0 }, sample_size { 0 };
+
+  /* How many of the requests before each sample are run through the caches to warm them
+   * up, without being counted. Requests before those are not simulated at all. By
+   * default, every request between samples warms the caches */
+  uint64_t warming { UINT64_MAX };
+
+  /* The seed for choosing the positions of random samples */
+  uint64_t seed { 0 };
+
+  bool enabled() const { return mode != SamplingMode::None; }
+};
+
+/* The requests between the end of one sample and the end of the next: `skip` requests
+ * that are not simulated, then `warm` requests that only warm the caches up, then the
+ * `measure` requests of the sample */
+struct SampleInterval {
+  uint64_t skip, warm, measure;
+};
+
+/* Generates the intervals of a sampled trace in order. Schedules built from the same
+ * config always generate the same intervals */
+class SampleSchedule {
+  const SamplingConfig config;
+  std::mt19937_64 rng;
+
+  /* The requests left over from the previous period, after its sample */
+  uint64_t carry { 0 };
+
+ public:
+  /* Throws if the config is not a valid sampling config */
+  explicit SampleSchedule(const SamplingConfig& config);
+
+  SampleInterval next();
+};
+
+/* The number of accesses and misses at each level during each sample of a simulation,
+ * used to estimate how far the sampled miss rates are from the full trace's */
+class SampleStats {
+  /* Indexed by [level - 1][sample] */
+  std::vector<std::vector<std::pair<uint64_t, uint64_t>>> samples;
+
+ public:
+  /* Record a sample, with the given accesses and misses for each level */
+  void add(const std::vector<uint64_t>& accesses, const std::vector<uint64_t>& misses);
+
+  /* The number of samples recorded */
+  size_t size() const;
+
+  /* The mean of the samples' miss rates at the given level, and the half-width of its
+   * 95% confidence interval. Samples where the level was never accessed are left out.
+   * Miss rates are between 0 and 1, so with fewer than two samples the half-width is 1,
+   * which bounds nothing */
+  std::pair<double, double> getMissRate(int level) const;
+};
+
+/* Runs the requests of a sampled trace through a cache hierarchy, following a
+ * `SampleSchedule`. Requests may be given in any number of pieces */
+class Sampler {
+  enum class Phase { Skip, Warm, Measure };
+
+  SampleSchedule schedule;
+  SampleInterval interval;
+  Phase phase { Phase::Skip };
+  uint64_t remaining;
+
+  /* Whether the requests to skip have already been dropped from the input (see
+   * `SampledTraceReader`) */
+  const bool input_skipped;
+
+  /* The accesses and misses at each level when the current sample started */
+  std::vector<uint64_t> start_accesses, start_misses;
+
+  SampleStats stats;
+  uint64_t measured { 0 };
+
+  void next_phase_(CacheHierarchy& cache);
+  void record_sample_(const CacheHierarchy& cache);
+
+ public:
+  Sampler(const SamplingConfig& config, bool input_skipped);
+
+  /* Run the next requests of the trace, calling `touch(cache, requests)` with each part
+   * of them that has to be simulated. `requests` must support `size()` and `subspan()` */
+  template <typename Requests, typename Touch>
+  void run(CacheHierarchy& cache, const Requests& requests, const Touch& touch) {
+    size_t offset { 0 };
+    while (offset < requests.size()) {
+      if (remaining == 0) {
+        next_phase_(cache);
+        continue;
+      }
+
+      const size_t n = std::min<uint64_t>(remaining, requests.size() - offset);
+      if (phase != Phase::Skip) touch(cache, requests.subspan(offset, n));
+      if (phase == Phase::Measure) measured += n;
+
+      offset += n;
+      remaining -= n;
+    }
+  }
+
+  /* Finish the simulation at the end of the trace, recording the last sample if it was
+   * started, and counting stats again if they were paused */
+  void finish(CacheHierarchy& cache);
+
+  /* The number of requests counted in the results */
+  uint64_t getMeasured() const;
+
+  const SampleStats& getStats() const;
+};
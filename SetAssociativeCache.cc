@@ -1,53 +1,71 @@
 #include "SetAssociativeCache.hh"
 
+#include <algorithm>
+
 SetAssociativeCache::SetAssociativeCache(const CacheConfig config,
                                          const std::shared_ptr<const Clock> clock)
-    : Cache(config, clock), cache_sets(size / (line_size * set_size)) {
-
-  for (size_t i = 0; i < cache_sets.size(); i++)
-    cache_sets[i] = std::vector<CacheEntry>(set_size, CacheEntry {});
-}
+    : Cache(config, clock),
+      tags(size / line_size, TagMatch::EMPTY_TAG),
+      match_ways(TagMatch::best().kernel),
+      last_used(size / line_size, 0),
+      loaded_at(size / line_size, 0) { }
 
 CacheEvents SetAssociativeCache::touch(const CacheAddress& address) {
-  CacheEntry* hit { nullptr };
   CacheEvents events {};
 
-  CacheEntry* oldest = &cache_sets[address.index][0];
-  uint64_t max_age   = oldest->age;
-  for (CacheEntry& cache_line : cache_sets[address.index]) {
-    cache_line.age += 1;
-    if (cache_line.tag == address.tag && cache_line.valid) hit = &cache_line;
-    if (cache_line.age > max_age) {
-      max_age = cache_line.age;
-      oldest  = &cache_line;
+  const uint64_t stamp = ++touches;
+  const size_t first   = static_cast<size_t>(address.index) * set_size;
+  for (int base = 0; base < set_size; base += TagMatch::MAX_WAYS) {
+    const int ways    = std::min(set_size - base, TagMatch::MAX_WAYS);
+    const auto masks  = match_ways(tags.data() + first + base, ways, address.tag);
+    uint64_t hit_ways = masks.hits & masks.valid;
+    if (address.tag == TagMatch::EMPTY_TAG)  // Empty ways hold it too, so skip them
+      for (int way = 0; way < ways; way++)
+        if (last_used[first + base + way] != 0)
+          hit_ways |= masks.hits & (uint64_t { 1 } << way);
+
+    if (hit_ways) {
+      last_used[first + base + __builtin_ctzll(hit_ways)] = stamp;
+      hits++;
+      events.hits++;
+      return events;
     }
   }
 
-  if (hit) {
-    hits++;
-    events.hits++;
-  } else {
-    if (oldest->valid) {
-      evictions++;
-      events.evictions++;
-      log_eviction(oldest->loaded_at);
-    }
-    misses++;
-    events.misses++;
+  // Lines that were never filled are the least recently used of all, and ties go to the
+  // first way
+  size_t victim = first;
+  for (size_t line = first + 1; line < first + set_size; line++)
+    if (last_used[line] < last_used[victim]) victim = line;
 
-    oldest->set(address.tag, clock_->current_cycle());
+  if (last_used[victim] != 0) {
+    evictions++;
+    events.evictions++;
+    log_eviction(loaded_at[victim]);
   }
+  misses++;
+  events.misses++;
+
+  tags[victim]      = address.tag;
+  last_used[victim] = stamp;
+  loaded_at[victim] = clock_->current_cycle();
 
   return events;
 }
 
+void SetAssociativeCache::touch_repeated(const CacheAddress&, uint64_t n) {
+  // The line was just touched, so it's already the most recently used one, and repeated
+  // hits leave it that way
+  hits += n;
+}
+
 /* Returns a a liftime map for the elements still in the cache */
 std::unique_ptr<std::map<uint64_t, uint64_t>> SetAssociativeCache::getActiveLifetimes()
     const {
   auto active_lifetimes = std::make_unique<std::map<uint64_t, uint64_t>>();
-  for (auto const& set : cache_sets)
-    for (auto const& line : set)
-      if (line.valid) (*active_lifetimes)[clock_->current_cycle() - line.loaded_at]++;
+  for (size_t line = 0; line < tags.size(); line++)
+    if (last_used[line] != 0)
+      (*active_lifetimes)[clock_->current_cycle() - loaded_at[line]]++;
 
   return active_lifetimes;
 }
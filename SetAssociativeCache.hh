@@ -1,13 +1,56 @@
 #pragma once
 
+#include <new>
 #include <vector>
 
+#include "TagMatch.hh"
 #include "cache.hh"
 
+/* Allocates storage aligned to host cache lines */
+template <typename T>
+struct CacheAlignedAllocator {
+  static constexpr std::align_val_t ALIGNMENT { 64 };
+
+  using value_type = T;
+
+  CacheAlignedAllocator() = default;
+  template <typename U>
+  CacheAlignedAllocator(const CacheAlignedAllocator<U>&) { }
+
+  T* allocate(size_t n) {
+    return static_cast<T*>(::operator new(n * sizeof(T), ALIGNMENT));
+  }
+  void deallocate(T* p, size_t) { ::operator delete(p, ALIGNMENT); }
+
+  template <typename U>
+  bool operator==(const CacheAlignedAllocator<U>&) const {
+    return true;
+  }
+  template <typename U>
+  bool operator!=(const CacheAlignedAllocator<U>&) const {
+    return false;
+  }
+};
+
+/* Lines are stored flat, set after set, with each field of a line in an array of its
+ * own. A lookup compares its set's tags all at once (see `TagMatch`), since they are
+ * contiguous and take one or two host cache lines for common associativities, and stamps
+ * the line it uses. The least recently used line of a set is the one evicted */
 class SetAssociativeCache : public Cache {
 
-  using CacheSet = std::vector<CacheEntry>;
-  std::vector<CacheSet> cache_sets;
+  /* Lines that were never filled hold `TagMatch::EMPTY_TAG`. A real tag can only be the
+   * same if the cache has a single set of 1-byte lines, so lookups of that tag check
+   * `last_used` too */
+  std::vector<uint64_t, CacheAlignedAllocator<uint64_t>> tags;
+  const TagMatch::Kernel match_ways;
+
+  /* When each line was last used, counted in touches of this cache from 1, or 0 if it
+   * was never filled */
+  std::vector<uint64_t> last_used;
+  uint64_t touches { 0 };
+
+  /* The cycle on which each line was filled */
+  std::vector<uint64_t> loaded_at;
 
   /* Returns a a liftime map for the elements still in the cache */
   virtual std::unique_ptr<std::map<uint64_t, uint64_t>> getActiveLifetimes()
@@ -18,5 +61,6 @@ class SetAssociativeCache : public Cache {
 
   using Cache::touch;
   virtual CacheEvents touch(const CacheAddress& address) override;
+  virtual void touch_repeated(const CacheAddress& address, uint64_t n) override;
   virtual CacheType getType() const override;
 };
@@ -0,0 +1,67 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include "MemoryTrace.hh"
+#include "ShmRing.hh"
+
+#define EXIT_INVALID_ARGUMENTS 1
+#define EXIT_INVALID_TRACE     2
+#define EXIT_RING_FAILED       3
+
+namespace {
+/* Requests are handed over in batches, so that each side only touches the ring's
+ * counters once every few thousand requests */
+constexpr size_t BATCH_SIZE = 4096;
+}  // namespace
+
+/* A stand-in for an instrumentation client: replays a trace into a shared memory ring
+ * that `scs shm:NAME` is reading from */
+int main(int argc, char* argv[]) {
+
+  if (argc < 3) {
+    std::cout << "Usage: shm-producer RING TRACE-FILE\n";
+    std::cout << "Writes the requests in TRACE-FILE to RING (`shm:NAME`), which `scs`\n";
+    std::cout << "must already be reading, or start reading within 10 seconds.\n";
+    std::exit(EXIT_INVALID_ARGUMENTS);
+  }
+
+  const std::string ring_name { argv[1] }, trace_fname { argv[2] };
+  TraceFileType encoding;
+  try {
+    encoding = MemoryTraceTools::guess_file_type(trace_fname);
+  } catch (const std::invalid_argument& e) {
+    std::exit(EXIT_INVALID_TRACE);
+  }
+  const MemoryTrace trace { trace_fname, encoding };
+  const auto requests = trace.getRequests();
+
+  try {
+    ShmRing::Producer ring { ring_name };
+
+    const auto t_start = std::chrono::steady_clock::now();
+    std::vector<MemoryRequest> batch;
+    batch.reserve(BATCH_SIZE);
+    for (size_t offset = 0; offset < requests.size(); offset += BATCH_SIZE) {
+      const auto part = requests.subspan(offset, BATCH_SIZE);
+      batch.assign(part.begin(), part.end());
+      if (!ring.write(batch.data(), batch.size())) {
+        std::cout << "The consumer closed the ring after " << offset << " requests\n";
+        std::exit(EXIT_RING_FAILED);
+      }
+    }
+    ring.close();
+
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - t_start;
+    std::cout << "Wrote " << requests.size() << " requests in " << elapsed.count()
+              << " s (" << requests.size() / std::max(elapsed.count(), 1e-9)
+              << " requests/s)\n";
+  } catch (const std::exception& e) {
+    std::cout << e.what() << "\n";
+    std::exit(EXIT_RING_FAILED);
+  }
+
+  return 0;
+}
@@ -0,0 +1,241 @@
+#include "ShmRing.hh"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
+
+namespace ShmRing {
+namespace {
+
+static_assert(std::is_trivially_copyable<MemoryRequest>::value,
+              "Requests are copied into shared memory as they are");
+
+/* Records start on the cache line after the header */
+constexpr size_t RECORDS_OFFSET = (sizeof(Header) + 63) / 64 * 64;
+
+/* How long a side sleeps before checking the ring again, in case a wakeup was missed
+ * because the other side died */
+constexpr long WAIT_TIMEOUT_NS = 100 * 1000 * 1000;
+
+/* Sleep until `word` no longer holds `seen`, or for a short while */
+void wait_for_change(std::atomic<uint32_t>& word, uint32_t seen) {
+#ifdef __linux__
+  const timespec timeout { 0, WAIT_TIMEOUT_NS };
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, &timeout,
+          nullptr, 0);
+#else
+  if (word.load() == seen) std::this_thread::sleep_for(std::chrono::microseconds(50));
+#endif
+}
+
+/* Wake every side sleeping on `word` */
+void wake(std::atomic<uint32_t>& word) {
+#ifdef __linux__
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, nullptr,
+          nullptr, 0);
+#else
+  (void)word;
+#endif
+}
+
+/* Bump `seq` after moving a counter, waking the other side if it's asleep */
+void signal(std::atomic<uint32_t>& seq, const std::atomic<uint32_t>& waiting) {
+  seq.fetch_add(1);
+  if (waiting.load()) wake(seq);
+}
+}  // namespace
+
+std::string object_name(const std::string& fname) {
+  std::string name = is_ring_name(fname) ? fname.substr(sizeof(NAME_PREFIX) - 1) : fname;
+  if (name.empty() || name.find('/', 1) != std::string::npos)
+    throw std::invalid_argument("Invalid shared memory ring name: " + fname);
+  return name[0] == '/' ? name : '/' + name;
+}
+
+// ------
+
+Ring::Ring(const std::string& fname) : name(object_name(fname)) { }
+
+Ring::~Ring() {
+  if (header) munmap(header, mapped_bytes);
+  if (fd >= 0) ::close(fd);
+}
+
+void Ring::map_() {
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < RECORDS_OFFSET)
+    throw std::runtime_error("Shared memory ring is too small: " + name);
+
+  void* data = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (data == MAP_FAILED)
+    throw std::runtime_error("Cannot map shared memory ring: " + name);
+
+  mapped_bytes = st.st_size;
+  header       = static_cast<Header*>(data);
+  records = reinterpret_cast<MemoryRequest*>(static_cast<char*>(data) + RECORDS_OFFSET);
+}
+
+uint64_t Ring::capacity() const { return header->capacity; }
+
+// ------
+
+Consumer::Consumer(const std::string& fname, uint64_t capacity) : Ring(fname) {
+  if (capacity == 0 || (capacity & (capacity - 1)) != 0)
+    throw std::invalid_argument("Shared memory ring capacity must be a power of two");
+
+  fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+    throw std::runtime_error("Cannot create shared memory ring " + name +
+                             (errno == EEXIST ? ": it already exists. If it was left "
+                                                "behind by a run that was killed, "
+                                                "remove /dev/shm" + name
+                                              : ""));
+
+  if (ftruncate(fd, RECORDS_OFFSET + capacity * sizeof(MemoryRequest)) != 0) {
+    shm_unlink(name.c_str());
+    throw std::runtime_error("Cannot allocate shared memory ring: " + name);
+  }
+  try {
+    map_();
+  } catch (...) {
+    shm_unlink(name.c_str());
+    throw;
+  }
+
+  // The object starts zeroed, so only the fixed fields need filling in
+  std::memcpy(header->magic, MAGIC, sizeof(MAGIC));
+  header->version     = VERSION;
+  header->record_size = sizeof(MemoryRequest);
+  header->capacity    = capacity;
+  header->ready.store(1, std::memory_order_release);
+}
+
+Consumer::~Consumer() {
+  header->closed.fetch_or(CONSUMER_CLOSED);
+  header->tail_seq.fetch_add(1);
+  wake(header->tail_seq);
+  shm_unlink(name.c_str());
+}
+
+size_t Consumer::read(MemoryRequest* out, size_t max) {
+  const uint64_t tail = header->tail.load(std::memory_order_relaxed);
+
+  uint64_t head = header->head.load(std::memory_order_acquire);
+  while (head == tail) {
+    // The producer writes everything before closing the ring, so look again after
+    if (header->closed.load() & PRODUCER_CLOSED) {
+      head = header->head.load(std::memory_order_acquire);
+      if (head == tail) return 0;
+      break;
+    }
+
+    // Announce the wait before looking once more, so that the producer either sees it
+    // and wakes us, or moved the head before we look
+    const uint32_t seen = header->head_seq.load();
+    header->consumer_waiting.store(1);
+    head = header->head.load();
+    if (head == tail && !(header->closed.load() & PRODUCER_CLOSED))
+      wait_for_change(header->head_seq, seen);
+    header->consumer_waiting.store(0);
+    head = header->head.load(std::memory_order_acquire);
+  }
+
+  const uint64_t mask = header->capacity - 1;
+  const size_t n      = std::min<uint64_t>(max, head - tail);
+  const size_t first  = std::min<uint64_t>(n, header->capacity - (tail & mask));
+  std::memcpy(out, records + (tail & mask), first * sizeof(MemoryRequest));
+  std::memcpy(out + first, records, (n - first) * sizeof(MemoryRequest));
+
+  header->tail.store(tail + n, std::memory_order_release);
+  signal(header->tail_seq, header->producer_waiting);
+  return n;
+}
+
+// ------
+
+Producer::Producer(const std::string& fname, int timeout_ms) : Ring(fname) {
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::milliseconds(timeout_ms);
+  const auto wait = [&](const char* what) {
+    if (std::chrono::steady_clock::now() > deadline)
+      throw std::runtime_error(std::string { "Timed out waiting for " } + what + ": " +
+                               name);
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  };
+
+  while ((fd = shm_open(name.c_str(), O_RDWR, 0)) < 0) wait("the ring to be created");
+
+  // The ring is sized before it's filled in, but it may not be sized yet
+  struct stat st;
+  while (fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) < RECORDS_OFFSET)
+    wait("the ring to be sized");
+  map_();
+
+  while (!header->ready.load(std::memory_order_acquire)) wait("the ring to be set up");
+
+  if (std::memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header->version != VERSION || header->record_size != sizeof(MemoryRequest) ||
+      mapped_bytes < RECORDS_OFFSET + header->capacity * sizeof(MemoryRequest))
+    throw std::runtime_error("Incompatible shared memory ring: " + name);
+}
+
+Producer::~Producer() { close(); }
+
+bool Producer::write(const MemoryRequest* requests, size_t n) {
+  const uint64_t capacity = header->capacity, mask = capacity - 1;
+  uint64_t head           = header->head.load(std::memory_order_relaxed);
+
+  while (n > 0) {
+    uint64_t tail = header->tail.load(std::memory_order_acquire);
+    while (head - tail == capacity) {
+      if (header->closed.load() & CONSUMER_CLOSED) return false;
+
+      const uint32_t seen = header->tail_seq.load();
+      header->producer_waiting.store(1);
+      tail = header->tail.load();
+      if (head - tail == capacity && !(header->closed.load() & CONSUMER_CLOSED))
+        wait_for_change(header->tail_seq, seen);
+      header->producer_waiting.store(0);
+      tail = header->tail.load(std::memory_order_acquire);
+    }
+    if (header->closed.load() & CONSUMER_CLOSED) return false;
+
+    const size_t batch = std::min<uint64_t>(n, capacity - (head - tail));
+    const size_t first = std::min<uint64_t>(batch, capacity - (head & mask));
+    std::memcpy(records + (head & mask), requests, first * sizeof(MemoryRequest));
+    std::memcpy(records, requests + first, (batch - first) * sizeof(MemoryRequest));
+
+    head += batch;
+    header->head.store(head, std::memory_order_release);
+    signal(header->head_seq, header->consumer_waiting);
+
+    requests += batch;
+    n -= batch;
+  }
+  return true;
+}
+
+void Producer::close() {
+  if (closed) return;
+  closed = true;
+
+  header->closed.fetch_or(PRODUCER_CLOSED);
+  header->head_seq.fetch_add(1);
+  wake(header->head_seq);
+}
+}  // namespace ShmRing
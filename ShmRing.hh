@@ -0,0 +1,126 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "MemoryTrace.hh"
+
+/* A ring of `MemoryRequest` records in POSIX shared memory, through which a tracing
+ * client (the producer) hands requests straight to `scs` (the consumer), with no
+ * formatting or parsing on either side.
+ *
+ * The shared memory object holds a `Header`, followed by `capacity` records. `head`
+ * counts the records ever written and `tail` the records ever read, so the ring is empty
+ * when they are equal and full when they are `capacity` apart. Each side only writes its
+ * own counter, and moves it once per batch of records. A side that finds the ring empty
+ * (or full) sleeps on a futex until the other side moves its counter or closes the ring.
+ *
+ * The consumer creates the ring, and removes it when it's done. Rings are named like
+ * traces, as `shm:NAME` */
+namespace ShmRing {
+
+constexpr char MAGIC[8]             = { 'S', 'C', 'S', 'S', 'H', 'M', 'R', 'G' };
+constexpr uint32_t VERSION          = 1;
+constexpr uint64_t DEFAULT_CAPACITY = 1 << 20;
+
+/* The prefix of trace names that refer to a ring */
+constexpr char NAME_PREFIX[] = "shm:";
+
+/* Bits of `Header::closed` */
+constexpr uint32_t PRODUCER_CLOSED = 0x1;
+constexpr uint32_t CONSUMER_CLOSED = 0x2;
+
+/* The counters each side writes are on cache lines of their own, so that the two sides
+ * don't keep stealing each other's lines */
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t record_size;
+  uint64_t capacity;
+
+  /* Set by the consumer once the rest of the header is filled in */
+  std::atomic<uint32_t> ready;
+
+  /* Written by the producer. `head_seq` changes whenever `head` does, and is the futex
+   * the consumer sleeps on */
+  alignas(64) std::atomic<uint64_t> head;
+  std::atomic<uint32_t> head_seq;
+  std::atomic<uint32_t> consumer_waiting;
+
+  /* Written by the consumer */
+  alignas(64) std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> tail_seq;
+  std::atomic<uint32_t> producer_waiting;
+
+  alignas(64) std::atomic<uint32_t> closed;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free &&
+                  std::atomic<uint32_t>::is_always_lock_free,
+              "Ring counters must be lock-free to be shared between processes");
+
+/* Check whether a trace name refers to a ring */
+inline bool is_ring_name(const std::string& fname) {
+  return fname.compare(0, sizeof(NAME_PREFIX) - 1, NAME_PREFIX) == 0;
+}
+
+/* The name of the shared memory object for a ring named `shm:NAME` */
+std::string object_name(const std::string& fname);
+
+/* A mapping of a ring's shared memory object */
+class Ring {
+ protected:
+  const std::string name;
+  int fd { -1 };
+  size_t mapped_bytes { 0 };
+  Header* header { nullptr };
+  MemoryRequest* records { nullptr };
+
+  explicit Ring(const std::string& fname);
+  ~Ring();
+
+  /* Map the ring's object, which must hold at least a header */
+  void map_();
+
+ public:
+  Ring(const Ring&) = delete;
+  Ring& operator=(const Ring&) = delete;
+
+  uint64_t capacity() const;
+};
+
+/* Creates a ring, and reads requests from it */
+class Consumer : public Ring {
+ public:
+  /* Throws if the ring already exists. `capacity` must be a power of two */
+  explicit Consumer(const std::string& fname, uint64_t capacity = DEFAULT_CAPACITY);
+
+  /* Closes and removes the ring. A producer still attached can't write to it anymore */
+  ~Consumer();
+
+  /* Read up to `max` requests into `out`, waiting until there are any. Returns the
+   * number of requests read, which is only 0 once the producer has closed the ring and
+   * every request has been read */
+  size_t read(MemoryRequest* out, size_t max);
+};
+
+/* Attaches to a ring, and writes requests to it */
+class Producer : public Ring {
+  bool closed { false };
+
+ public:
+  /* Wait up to `timeout_ms` milliseconds for the consumer to create the ring, then
+   * attach to it. Throws if it never does */
+  explicit Producer(const std::string& fname, int timeout_ms = 10000);
+
+  /* Closes the ring, if it wasn't already */
+  ~Producer();
+
+  /* Write `n` requests, waiting for room in the ring as needed. Returns false if the
+   * consumer has gone away, in which case not all of the requests may have been read */
+  bool write(const MemoryRequest* requests, size_t n);
+
+  /* Tell the consumer that no more requests will be written */
+  void close();
+};
+}  // namespace ShmRing
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <type_traits>
+
+/* A non-owning view of a contiguous sequence of elements, like C++20's `std::span`.
+ * The viewed elements must outlive the span */
+template <typename T>
+class Span {
+  T* data_ { nullptr };
+  size_t size_ { 0 };
+
+ public:
+  using value_type     = std::remove_cv_t<T>;
+  using iterator       = T*;
+  using const_iterator = T*;
+
+  constexpr Span() = default;
+  constexpr Span(T* data, size_t size) : data_(data), size_(size) { }
+  constexpr Span(T* first, T* last) : data_(first), size_(last - first) { }
+
+  /* View the whole of a contiguous container, such as a `std::vector` */
+  template <typename Container,
+            typename = std::enable_if_t<std::is_convertible_v<
+                decltype(std::declval<Container&>().data()), T*>>>
+  constexpr Span(Container& container)
+      : data_(container.data()), size_(container.size()) { }
+
+  constexpr T* data() const { return data_; }
+  constexpr size_t size() const { return size_; }
+  constexpr bool empty() const { return size_ == 0; }
+
+  constexpr T& operator[](size_t i) const { return data_[i]; }
+
+  constexpr T* begin() const { return data_; }
+  constexpr T* end() const { return data_ + size_; }
+
+  /* A view of `count` elements starting at `offset`, clamped to the end of this span */
+  constexpr Span subspan(size_t offset, size_t count = static_cast<size_t>(-1)) const {
+    if (offset > size_) offset = size_;
+    if (count > size_ - offset) count = size_ - offset;
+    return Span { data_ + offset, count };
+  }
+};
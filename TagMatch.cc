@@ -0,0 +1,144 @@
+#include "TagMatch.hh"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#ifdef __ARM_FEATURE_SVE
+#include <arm_sve.h>
+#endif
+#ifdef __linux__
+#include <sys/auxv.h>
+#endif
+#endif
+
+namespace TagMatch {
+namespace {
+
+WayMasks match_portable(const uint64_t* tags, int ways, uint64_t tag) {
+  WayMasks masks { 0, 0 };
+  for (int way = 0; way < ways; way++) {
+    masks.hits |= static_cast<uint64_t>(tags[way] == tag) << way;
+    masks.valid |= static_cast<uint64_t>(tags[way] != EMPTY_TAG) << way;
+  }
+  return masks;
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("avx512f"))) WayMasks match_avx512(const uint64_t* tags, int ways,
+                                                         uint64_t tag) {
+  const __m512i wanted = _mm512_set1_epi64(static_cast<long long>(tag));
+  const __m512i empty  = _mm512_set1_epi64(static_cast<long long>(EMPTY_TAG));
+
+  // The last few ways are loaded under a mask, which never faults past the set
+  WayMasks masks { 0, 0 };
+  for (int way = 0; way < ways; way += 8) {
+    const __mmask8 lanes = ways - way >= 8 ? 0xff : (1u << (ways - way)) - 1;
+    const __m512i set    = _mm512_maskz_loadu_epi64(lanes, tags + way);
+    masks.hits |= static_cast<uint64_t>(_mm512_mask_cmpeq_epi64_mask(lanes, set, wanted))
+                  << way;
+    masks.valid |= static_cast<uint64_t>(_mm512_mask_cmpneq_epi64_mask(lanes, set, empty))
+                   << way;
+  }
+  return masks;
+}
+
+/* The lanes of a comparison result that are set, one bit per lane */
+__attribute__((target("avx2"))) inline uint64_t lane_mask(__m256i equal) {
+  return static_cast<uint64_t>(_mm256_movemask_pd(_mm256_castsi256_pd(equal)));
+}
+
+__attribute__((target("avx2"))) WayMasks match_avx2(const uint64_t* tags, int ways,
+                                                    uint64_t tag) {
+  const __m256i wanted = _mm256_set1_epi64x(static_cast<long long>(tag));
+  const __m256i empty  = _mm256_set1_epi64x(static_cast<long long>(EMPTY_TAG));
+
+  WayMasks masks { 0, 0 };
+  int way { 0 };
+  for (; way + 4 <= ways; way += 4) {
+    const __m256i set = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(tags + way));
+    masks.hits |= lane_mask(_mm256_cmpeq_epi64(set, wanted)) << way;
+    masks.valid |= (~lane_mask(_mm256_cmpeq_epi64(set, empty)) & 0xf) << way;
+  }
+  if (way < ways) {
+    const WayMasks rest = match_portable(tags + way, ways - way, tag);
+    masks.hits |= rest.hits << way;
+    masks.valid |= rest.valid << way;
+  }
+  return masks;
+}
+
+#elif defined(__aarch64__)
+
+#ifdef __ARM_FEATURE_SVE
+WayMasks match_sve(const uint64_t* tags, int ways, uint64_t tag) {
+  // Each lane contributes its way's bit, and the bits of matching lanes are ORed together
+  WayMasks masks { 0, 0 };
+  for (int way = 0; way < ways; way += static_cast<int>(svcntd())) {
+    const svbool_t lanes = svwhilelt_b64(way, ways);
+    const svuint64_t set = svld1_u64(lanes, tags + way);
+    const svuint64_t bits =
+        svlsl_u64_x(lanes, svdup_n_u64(1), svindex_u64(static_cast<uint64_t>(way), 1));
+    masks.hits |= svorv_u64(svcmpeq_n_u64(lanes, set, tag), bits);
+    masks.valid |= svorv_u64(svcmpne_n_u64(lanes, set, EMPTY_TAG), bits);
+  }
+  return masks;
+}
+#endif
+
+/* The lanes of a comparison result that are set, one bit per lane */
+inline uint64_t lane_mask(uint64x2_t equal) {
+  return (vgetq_lane_u64(equal, 0) & 0x1) | (vgetq_lane_u64(equal, 1) & 0x2);
+}
+
+WayMasks match_neon(const uint64_t* tags, int ways, uint64_t tag) {
+  const uint64x2_t wanted = vdupq_n_u64(tag);
+  const uint64x2_t empty  = vdupq_n_u64(EMPTY_TAG);
+
+  WayMasks masks { 0, 0 };
+  int way { 0 };
+  for (; way + 2 <= ways; way += 2) {
+    const uint64x2_t set = vld1q_u64(tags + way);
+    masks.hits |= lane_mask(vceqq_u64(set, wanted)) << way;
+    masks.valid |= (~lane_mask(vceqq_u64(set, empty)) & 0x3) << way;
+  }
+  if (way < ways) {
+    const WayMasks rest = match_portable(tags + way, ways - way, tag);
+    masks.hits |= rest.hits << way;
+    masks.valid |= rest.valid << way;
+  }
+  return masks;
+}
+
+#endif
+
+std::vector<Implementation> detect() {
+  std::vector<Implementation> kernels;
+
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) kernels.push_back({ "avx512", match_avx512 });
+  if (__builtin_cpu_supports("avx2")) kernels.push_back({ "avx2", match_avx2 });
+#elif defined(__aarch64__)
+#ifdef __ARM_FEATURE_SVE
+#if defined(__linux__) && defined(HWCAP_SVE)
+  if (getauxval(AT_HWCAP) & HWCAP_SVE)
+#endif
+    kernels.push_back({ "sve", match_sve });
+#endif
+  kernels.push_back({ "neon", match_neon });
+#endif
+
+  kernels.push_back({ "portable", match_portable });
+  return kernels;
+}
+}  // namespace
+
+const std::vector<Implementation>& available() {
+  static const std::vector<Implementation> kernels = detect();
+  return kernels;
+}
+
+const Implementation& best() { return available().front(); }
+}  // namespace TagMatch
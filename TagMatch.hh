@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+/* Kernels that compare a tag against every way of a cache set at once. Each one returns a
+ * mask of the ways holding the tag, and a mask of the ways holding any line at all.
+ *
+ * x86 hosts get an AVX-512 or AVX2 kernel if their CPU supports it, which is checked at
+ * run time, so one build runs everywhere. aarch64 hosts get an SVE kernel when built for
+ * SVE (as with `-mcpu=a64fx`), and a NEON kernel otherwise. Other hosts get a portable
+ * loop */
+namespace TagMatch {
+
+/* The tag of ways that hold no line */
+constexpr uint64_t EMPTY_TAG = UINT64_MAX;
+
+/* The most ways compared in one call */
+constexpr int MAX_WAYS = 64;
+
+/* Bit w of `hits` is set if way w holds the tag, and of `valid` if way w isn't empty */
+struct WayMasks {
+  uint64_t hits, valid;
+};
+
+/* Compare `tag` against the `ways` tags starting at `tags`, where `ways` is at most
+ * `MAX_WAYS` */
+using Kernel = WayMasks (*)(const uint64_t* tags, int ways, uint64_t tag);
+
+struct Implementation {
+  const char* name;
+  Kernel kernel;
+};
+
+/* The kernels this host can run, fastest first. The portable kernel is always last */
+const std::vector<Implementation>& available();
+
+/* The fastest kernel this host can run */
+const Implementation& best();
+}  // namespace TagMatch
@@ -1,48 +1,292 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <exception>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string_view>
+#include <thread>
 
+#include "BinaryTrace.hh"
+#include "CompressedTrace.hh"
+#include "MappedFile.hh"
 #include "MemoryTrace.hh"
 #include "TraceConverter.hh"
 
+#include <sys/mman.h>
+
 namespace TraceConverter {
 namespace {
 bool file_exists(const std::string& fname) {
   std::ifstream f { fname };
   return f.is_open();
 }
+
+/* Outputs are written under a temporary name, and only renamed once all of them are
+ * complete, so a failed conversion never leaves a trace behind that looks valid */
+std::string temporary_name(const std::string& fname) { return fname + ".tmp"; }
+
+void commit_outputs(const std::vector<std::string>& fnames) {
+  for (const auto& fname : fnames)
+    if (std::rename(temporary_name(fname).c_str(), fname.c_str()) != 0)
+      throw std::runtime_error("Cannot rename " + temporary_name(fname) + " to " + fname);
+}
+
+void discard_outputs(const std::vector<std::string>& fnames) {
+  for (const auto& fname : fnames) std::remove(temporary_name(fname).c_str());
+}
+
+/* Returns the start of the line after the one starting at `pos` */
+const char* next_line(const char* pos, const char* end) {
+  const auto newline = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+  return newline ? newline + 1 : end;
+}
+
+/* Parse the whole lines in [first, last) into one part per thread, in file order */
+void parse_window(const char* first, const char* last,
+                  std::vector<std::vector<MemoryRequest>>& parts) {
+  const size_t nparts = parts.size();
+  const size_t bytes  = last - first;
+
+  std::vector<const char*> part_starts { first };
+  for (size_t p = 1; p < nparts; p++) {
+    const char* split = first + std::max<size_t>(bytes / nparts * p, 1) - 1;
+    part_starts.push_back(std::max(part_starts.back(), next_line(split, last)));
+  }
+  part_starts.push_back(last);
+
+  std::vector<std::thread> threads;
+  std::vector<std::exception_ptr> errors(nparts);
+  for (size_t p = 0; p < nparts; p++) {
+    threads.emplace_back([&, p]() {
+      try {
+        auto& part = parts[p];
+        part.clear();
+
+        MemoryRequest request;
+        for (const char* pos = part_starts[p]; pos < part_starts[p + 1];) {
+          const char* next = next_line(pos, part_starts[p + 1]);
+          const char* eol  = next[-1] == '\n' ? next - 1 : next;
+          if (MemoryTraceTools::parse_text_line({ pos, static_cast<size_t>(eol - pos) },
+                                                request))
+            part.push_back(request);
+          pos = next;
+        }
+      } catch (...) {
+        errors[p] = std::current_exception();
+      }
+    });
+  }
+
+  for (auto& t : threads) t.join();
+  for (const auto& e : errors)
+    if (e) std::rethrow_exception(e);
+}
+
+/* Writes each request to the trace of its partition, splitting requests that cross a
+ * line boundary into one request per line */
+template <typename Writer>
+class PartitionWriter {
+  const int line_size;
+  const uint64_t mask;
+  std::vector<std::unique_ptr<Writer>> writers;
+
+ public:
+  /* Partition p is written to `fnames[p]`, and there must be a power of 2 of them. Each
+   * partition's writer is given `writer_size`, its buffer or block size */
+  PartitionWriter(const std::vector<std::string>& fnames, int line_size,
+                  size_t writer_size)
+      : line_size(line_size), mask(fnames.size() - 1) {
+    for (const auto& fname : fnames)
+      writers.push_back(std::make_unique<Writer>(fname, writer_size));
+  }
+
+  void write(MemoryRequest request) {
+    uint64_t line = request.address / line_size;
+    while (request.size > 0 &&
+           (request.address + request.size - 1) / line_size != line) {
+      MemoryRequest piece = request;
+      piece.size          = (line + 1) * line_size - request.address;
+      writers[line & mask]->write(piece);
+
+      request.address += piece.size;
+      request.size -= piece.size;
+      request.bundle_kind = 0;
+      line++;
+    }
+    writers[line & mask]->write(request);
+  }
+
+  void finish() {
+    for (auto& writer : writers) writer->finish();
+  }
+};
+
+/* Stream the text trace in `in_fname` to a `Writer` constructed from `writer_args`, one
+ * window at a time */
+template <typename Writer, typename... WriterArgs>
+void convert_stream(const std::string& in_fname, int io_threads, size_t window_bytes,
+                    const WriterArgs&... writer_args) {
+  // Open the input first, so that no output is left behind if it's missing
+  const MappedFile tracefile { in_fname };
+  tracefile.advise(MADV_SEQUENTIAL);
+  Writer writer { writer_args... };
+
+  const char* const data = tracefile.data();
+  const char* const end  = data + tracefile.size();
+
+  std::vector<std::vector<MemoryRequest>> parts(std::max(io_threads, 1));
+  for (const char* window = data; window < end;) {
+    // Windows end on a newline, so lines are never split between windows
+    const char* window_end =
+        next_line(window + std::min<size_t>(window_bytes, end - window) - 1, end);
+
+    parse_window(window, window_end, parts);
+    for (const auto& part : parts)
+      for (const auto& request : part) writer.write(request);
+
+    // The window is never read again, so drop it from this process' working set
+    tracefile.advise(MADV_DONTNEED, window - data, window_end - window);
+    window = window_end;
+  }
+
+  writer.finish();
+}
 }  // namespace
 
 ConvertStatus convert(const std::string& in_fname, const std::string& out_fname,
-                      bool force, bool display_progress) noexcept {
-  if (display_progress) std::cout << in_fname << " --> " << out_fname << "... ";
+                      bool force, bool display_progress, OutputFormat format,
+                      int io_threads, size_t window_bytes) noexcept {
+  // The whole message is printed at once, so that concurrent conversions don't interleave
+  std::ostringstream progress;
+  progress << in_fname << " --> " << out_fname << "... ";
 
+  ConvertStatus status { ConvertStatus::Success };
   bool existed = file_exists(out_fname);
   if (existed && !force) {
-    if (display_progress) std::cout << "EXISTS\n";
-    return ConvertStatus::AlreadyExists;
+    progress << "EXISTS\n";
+    status = ConvertStatus::AlreadyExists;
+  } else {
+    const std::vector<std::string> out_fnames { out_fname };
+    try {
+      if (format == OutputFormat::Compressed)
+        convert_stream<CompressedTrace::Writer>(in_fname, io_threads, window_bytes,
+                                                temporary_name(out_fname));
+      else
+        convert_stream<BinaryTrace::Writer>(in_fname, io_threads, window_bytes,
+                                            temporary_name(out_fname));
+      commit_outputs(out_fnames);
+
+      progress << (existed ? "OVERWRITTEN\n" : "DONE\n");
+    } catch (std::exception& e) {
+      discard_outputs(out_fnames);
+      progress << "FAILED\n" << e.what() << "\n";
+      status = ConvertStatus::Error;
+    }
   }
 
-  try {
-    MemoryTrace trace { std::ifstream { in_fname } };
-    trace.write_binary(out_fname);
+  if (display_progress) std::cout << progress.str() << std::flush;
+  return status;
+}
+
+ConvertStatus partition(const std::string& in_fname, const std::string& out_fname,
+                        int bits, int line_size, bool force, bool display_progress,
+                        OutputFormat format, int io_threads, size_t window_bytes) noexcept {
+  std::ostringstream progress;
+  progress << in_fname << " --> ";
 
-  } catch (std::exception& e) {
-    if (display_progress) std::cout << "FAILED\n" << e.what() << "\n";
-    return ConvertStatus::Error;
+  ConvertStatus status { ConvertStatus::Success };
+  if (bits < 0 || bits > MAX_PARTITION_BITS || line_size <= 0) {
+    progress << out_fname << "... FAILED\nPartitions must use between 0 and "
+             << MAX_PARTITION_BITS << " bits of the index of non-empty lines\n";
+    status = ConvertStatus::Error;
+  } else {
+    const int npartitions = 1 << bits;
+    progress << make_partition_name(out_fname, 0) << " ... "
+             << make_partition_name(out_fname, npartitions - 1) << "... ";
+
+    std::vector<std::string> out_fnames, tmp_fnames;
+    bool existed { false };
+    for (int p = 0; p < npartitions; p++) {
+      out_fnames.push_back(make_partition_name(out_fname, p));
+      tmp_fnames.push_back(temporary_name(out_fnames.back()));
+      existed = existed || file_exists(out_fnames.back());
+    }
+
+    if (existed && !force) {
+      progress << "EXISTS\n";
+      status = ConvertStatus::AlreadyExists;
+    } else {
+      try {
+        // Partitions share the memory a single trace would use for its buffer or block
+        if (format == OutputFormat::Compressed)
+          convert_stream<PartitionWriter<CompressedTrace::Writer>>(
+              in_fname, io_threads, window_bytes, tmp_fnames, line_size,
+              std::max<size_t>(CompressedTrace::DEFAULT_BLOCK_SIZE >> bits, 1024));
+        else
+          convert_stream<PartitionWriter<BinaryTrace::Writer>>(
+              in_fname, io_threads, window_bytes, tmp_fnames, line_size,
+              std::max<size_t>(BinaryTrace::WRITE_BUFFER_RECORDS >> bits, 1024));
+        commit_outputs(out_fnames);
+
+        progress << (existed ? "OVERWRITTEN\n" : "DONE\n");
+      } catch (std::exception& e) {
+        discard_outputs(out_fnames);
+        progress << "FAILED\n" << e.what() << "\n";
+        status = ConvertStatus::Error;
+      }
+    }
   }
 
-  if (display_progress) {
-    if (!existed)
-      std::cout << "DONE\n";
-    else
-      std::cout << "OVERWRITTEN\n";
+  if (display_progress) std::cout << progress.str() << std::flush;
+  return status;
+}
+
+std::vector<ConvertStatus> convert_all(
+    const std::vector<std::pair<std::string, std::string>>& fnames, bool force,
+    bool display_progress, OutputFormat format, int jobs) noexcept {
+  std::vector<ConvertStatus> statuses(fnames.size(), ConvertStatus::Error);
+
+  const size_t nworkers    = std::max<size_t>(1, std::min<size_t>(jobs, fnames.size()));
+  const int worker_threads = std::max(1, jobs / static_cast<int>(nworkers));
+
+  // Workers take the next unconverted file until there are none left
+  std::atomic<size_t> next { 0 };
+  const auto work = [&]() {
+    for (size_t i = next++; i < fnames.size(); i = next++)
+      statuses[i] = convert(fnames[i].first, fnames[i].second, force, display_progress,
+                            format, worker_threads);
+  };
+
+  std::vector<std::thread> workers;
+  try {
+    for (size_t w = 1; w < nworkers; w++) workers.emplace_back(work);
+  } catch (...) {
+    // Carry on with however many workers could be started
   }
+  work();
 
-  return ConvertStatus::Success;
+  for (auto& w : workers) w.join();
+  return statuses;
 }
 
 std::string make_default_outname(const std::string& in_fname) {
   return in_fname.substr(0, in_fname.rfind('.')) + ".bin";
 }
 
+std::string make_partition_name(const std::string& out_fname, int partition) {
+  // Only dots in the file name itself start an extension, not those in directory names
+  const auto slash = out_fname.rfind('/');
+  auto dot         = out_fname.rfind('.');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    dot = out_fname.size();
+
+  return out_fname.substr(0, dot) + "." + std::to_string(partition) +
+         out_fname.substr(dot);
+}
+
 }  // namespace TraceConverter
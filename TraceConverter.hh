@@ -1,15 +1,58 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
+
+/* The amount of text trace parsed at a time while converting */
+#define DEFAULT_CONVERT_WINDOW_BYTES (64 << 20)
+
+/* The most bits of the line index that traces can be partitioned by. Every partition
+ * buffers its own output, so memory use grows with the number of partitions */
+#define MAX_PARTITION_BITS 10
 
 namespace TraceConverter {
 
 enum class ConvertStatus { Success, Error, AlreadyExists };
 
-/* Convert a text trace file to a binary trace file */
+enum class OutputFormat { Binary, Compressed };
+
+/* Convert a text trace file to a binary trace file. The input is streamed through a
+ * window of `window_bytes`, each of which is parsed on up to `io_threads` threads, so
+ * memory use does not depend on the size of the trace */
 ConvertStatus convert(const std::string& in_fname, const std::string& out_fname,
-                      bool force, bool display_progress = true) noexcept;
+                      bool force, bool display_progress = true,
+                      OutputFormat format = OutputFormat::Binary, int io_threads = 1,
+                      size_t window_bytes = DEFAULT_CONVERT_WINDOW_BYTES) noexcept;
+
+/* Convert several (input, output) pairs of trace files, up to `jobs` at a time. When
+ * there are fewer files than jobs, the spare threads are used to parse each file */
+std::vector<ConvertStatus> convert_all(
+    const std::vector<std::pair<std::string, std::string>>& fnames, bool force,
+    bool display_progress = true, OutputFormat format = OutputFormat::Binary,
+    int jobs = 1) noexcept;
+
+/* Split a text trace into 2^`bits` binary traces by the low `bits` bits of the index of
+ * the `line_size` byte line each request falls in. Requests keep their order within each
+ * partition. Requests that cross a line boundary are split into one request per line,
+ * and only the first of these keeps the request's bundle kind.
+ *
+ * Caches whose sets only ever hold lines from one partition give the same hits, misses,
+ * evictions, and traffic when each partition is simulated on its own and the results
+ * are added up. That needs every level to use `line_size` byte lines and to have at
+ * least 2^`bits` sets, which partitions don't record, so nothing checks it when they
+ * are simulated. Partition p is written to
+ * `make_partition_name(out_fname, p)`. Memory use does not depend on the size of the
+ * trace, as with `convert` */
+ConvertStatus partition(const std::string& in_fname, const std::string& out_fname,
+                        int bits, int line_size, bool force, bool display_progress = true,
+                        OutputFormat format = OutputFormat::Binary, int io_threads = 1,
+                        size_t window_bytes = DEFAULT_CONVERT_WINDOW_BYTES) noexcept;
 
 /* Replace the extension in the given file name with '.bin' */
 std::string make_default_outname(const std::string& in_fname);
+
+/* The name of the given partition of a trace written to `out_fname`: the partition
+ * number is inserted before the extension */
+std::string make_partition_name(const std::string& out_fname, int partition);
 }  // namespace TraceConverter
@@ -1,6 +1,10 @@
 #include <unistd.h>
+#include <algorithm>
 #include <cstring>
 #include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
 
 #include "TraceConverter.hh"
 
@@ -10,6 +14,7 @@ using namespace TraceConverter;
 #define EXIT_INVALID_ARGUMENTS 2
 #define EXIT_INPUT_NOT_FOUND   3
 #define EXIT_OUTPUT_EXISTS     4
+#define EXIT_CONVERSION_FAILED 5
 
 void usage(int exit_code = -1);
 
@@ -17,8 +22,10 @@ int main(int argc, char* argv[]) {
   signed char opt;
   std::string out_fname;
   bool force { false };
+  OutputFormat format { OutputFormat::Binary };
+  int jobs { 1 }, partition_bits { -1 }, line_size { 64 };
 
-  while ((opt = getopt(argc, argv, "fho:")) != -1) {
+  while ((opt = getopt(argc, argv, "fhj:L:o:P:z")) != -1) {
     switch (opt) {
       case 'f':
         force = true;
@@ -26,9 +33,37 @@ int main(int argc, char* argv[]) {
       case 'h':
         usage(0);
         break;
+      case 'j':
+        try {
+          jobs = std::stoi(optarg);
+        } catch (const std::exception& e) {
+          usage(EXIT_INVALID_ARGUMENTS);
+        }
+        if (jobs < 1) usage(EXIT_INVALID_ARGUMENTS);
+        break;
+      case 'L':
+        try {
+          line_size = std::stoi(optarg);
+        } catch (const std::exception& e) {
+          usage(EXIT_INVALID_ARGUMENTS);
+        }
+        if (line_size < 1) usage(EXIT_INVALID_ARGUMENTS);
+        break;
       case 'o':
         out_fname = optarg;
         break;
+      case 'P':
+        try {
+          partition_bits = std::stoi(optarg);
+        } catch (const std::exception& e) {
+          usage(EXIT_INVALID_ARGUMENTS);
+        }
+        if (partition_bits < 0 || partition_bits > MAX_PARTITION_BITS)
+          usage(EXIT_INVALID_ARGUMENTS);
+        break;
+      case 'z':
+        format = OutputFormat::Compressed;
+        break;
       case '?':
       default:
         usage(EXIT_INVALID_OPTION);
@@ -39,25 +74,45 @@ int main(int argc, char* argv[]) {
 
   if (argc < 1 || (argc > 1 && !out_fname.empty())) usage(EXIT_INVALID_ARGUMENTS);
 
-  if (!out_fname.empty()) {
-    const std::string in_fname { argv[0] };
+  if (partition_bits >= 0) {
+    if (argc > 1) usage(EXIT_INVALID_ARGUMENTS);
+    if (out_fname.empty()) out_fname = make_default_outname(argv[0]);
 
-    convert(in_fname, out_fname, force);
+    const auto status = partition(argv[0], out_fname, partition_bits, line_size, force,
+                                  true, format, jobs);
+    return status == ConvertStatus::Error ? EXIT_CONVERSION_FAILED : 0;
+  }
+
+  std::vector<std::pair<std::string, std::string>> fnames;
+  if (!out_fname.empty()) {
+    fnames.emplace_back(argv[0], out_fname);
   } else {
     for (int i = 0; i < argc; i++) {
       const std::string in_fname { argv[i] };
-      const std::string out_fname = make_default_outname(in_fname);
-
-      convert(in_fname, out_fname, force);
+      fnames.emplace_back(in_fname, make_default_outname(in_fname));
     }
   }
 
+  const auto statuses = convert_all(fnames, force, true, format, jobs);
+  if (std::find(statuses.begin(), statuses.end(), ConvertStatus::Error) != statuses.end())
+    return EXIT_CONVERSION_FAILED;
+
   return 0;
 }
 
 void usage(int exit_code) {
   std::cout << "Usage:\n";
-  std::cout << "  convert-trace [-f] [-o OUTPUT] INPUT\n";
-  std::cout << "  convert-trace [-f] INPUT...\n";
+  std::cout << "  convert-trace [-f] [-z] [-j N] [-o OUTPUT] INPUT\n";
+  std::cout << "  convert-trace [-f] [-z] [-j N] INPUT...\n";
+  std::cout << "  convert-trace [-f] [-z] [-j N] -P BITS [-L LINE] [-o OUTPUT] INPUT\n";
+  std::cout << "\n";
+  std::cout << "  -f  Overwrite existing output files\n";
+  std::cout << "  -j  Use N threads, converting up to N files at once. Spare threads are used\n";
+  std::cout << "      to parse each file in parallel. Default: 1\n";
+  std::cout << "  -z  Write the compressed, block-indexed (v2) binary format\n";
+  std::cout << "  -P  Split the trace into 2^BITS traces by the low BITS bits of each request's\n";
+  std::cout << "      line index, written to OUTPUT with the partition number before the\n";
+  std::cout << "      extension. At most " << MAX_PARTITION_BITS << " bits\n";
+  std::cout << "  -L  The line size in bytes to partition by. Default: 64\n";
   std::exit(exit_code);
 }
@@ -0,0 +1,461 @@
+#include "TraceReader.hh"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <sys/mman.h>
+
+TraceReader::~TraceReader() { }
+
+size_t TraceReader::skip(size_t n) {
+  std::vector<MemoryRequest> discard(std::min<size_t>(n, 1 << 12));
+
+  size_t skipped { 0 };
+  while (skipped < n) {
+    const size_t read_now = read(discard.data(), std::min(n - skipped, discard.size()));
+    if (read_now == 0) break;
+    skipped += read_now;
+  }
+  return skipped;
+}
+
+void TraceReader::set_readahead(size_t requests) { readahead = requests; }
+
+std::unique_ptr<TraceReader> TraceReader::open(const std::string& fname,
+                                               TraceFileType ftype, size_t first,
+                                               size_t count, const TraceFilter& filter) {
+  return restrict_(open_(fname, ftype), first, count, filter);
+}
+
+std::unique_ptr<TraceReader> TraceReader::open(const std::vector<std::string>& fnames,
+                                               TraceFileType ftype, size_t first,
+                                               size_t count, const TraceFilter& filter) {
+  if (fnames.size() == 1) return open(fnames[0], ftype, first, count, filter);
+  if (ftype != TraceFileType::Text)
+    throw std::invalid_argument("Only text traces can be merged by sequence number");
+
+  std::vector<std::unique_ptr<TextTraceReader>> readers;
+  readers.reserve(fnames.size());
+  for (const auto& fname : fnames)
+    readers.push_back(std::make_unique<TextTraceReader>(fname == "-" ? "/dev/stdin"
+                                                                     : fname));
+
+  return restrict_(std::make_unique<MergedTraceReader>(std::move(readers)), first, count,
+                   filter);
+}
+
+std::unique_ptr<TraceReader> TraceReader::restrict_(std::unique_ptr<TraceReader> reader,
+                                                    size_t first, size_t count,
+                                                    const TraceFilter& filter) {
+  if (first != 0 || count != SIZE_MAX)
+    reader = std::make_unique<WindowedTraceReader>(std::move(reader), first, count);
+  if (!filter.empty())
+    reader = std::make_unique<FilteredTraceReader>(std::move(reader), filter);
+  return reader;
+}
+
+std::unique_ptr<TraceReader> TraceReader::open_(const std::string& fname,
+                                                TraceFileType ftype) {
+  // Rings hold requests as they are, whatever the encoding of the trace they came from
+  if (ShmRing::is_ring_name(fname)) return std::make_unique<ShmTraceReader>(fname);
+
+  if (MemoryTraceTools::is_live_input(fname)) {
+    // Opening stdin as a file gives it a buffered filebuf, which reads much faster than
+    // std::cin does while it's synchronised with C stdio
+    const std::string path = fname == "-" ? "/dev/stdin" : fname;
+    switch (ftype) {
+      case TraceFileType::Text:
+        return std::make_unique<TextTraceReader>(path);
+      case TraceFileType::Binary:
+        return std::make_unique<StreamedBinaryTraceReader>(path);
+      case TraceFileType::Compressed:
+        throw std::invalid_argument("Compressed traces cannot be read from a pipe");
+      case TraceFileType::Lackey:
+        return std::make_unique<ForeignTraceReader<LackeyTrace::Reader>>(path);
+      case TraceFileType::DrCacheSim:
+        return std::make_unique<ForeignTraceReader<DrCacheSimTrace::Reader>>(path);
+      default:
+        throw std::invalid_argument("Unknown trace file type");
+    }
+  }
+
+  switch (ftype) {
+    case TraceFileType::Text:
+      return std::make_unique<MappedTextTraceReader>(fname);
+    case TraceFileType::Binary:
+      return std::make_unique<BinaryTraceReader>(fname);
+    case TraceFileType::Compressed:
+      return std::make_unique<CompressedTraceReader>(fname);
+    case TraceFileType::Lackey:
+      return std::make_unique<ForeignTraceReader<LackeyTrace::Reader>>(fname);
+    case TraceFileType::DrCacheSim:
+      return std::make_unique<ForeignTraceReader<DrCacheSimTrace::Reader>>(fname);
+    default:
+      throw std::invalid_argument("Unknown trace file type");
+  }
+}
+
+// ------
+
+WindowedTraceReader::WindowedTraceReader(std::unique_ptr<TraceReader> reader,
+                                         size_t first, size_t count)
+    : reader(std::move(reader)), first(first), remaining(count) { }
+
+size_t WindowedTraceReader::read(MemoryRequest* out, size_t max) {
+  // Skip lazily, so that it happens on the thread doing the reading
+  if (!skipped) {
+    reader->skip(first);
+    skipped = true;
+  }
+
+  const size_t n = reader->read(out, std::min(max, remaining));
+  remaining -= n;
+  return n;
+}
+
+void WindowedTraceReader::set_readahead(size_t requests) {
+  reader->set_readahead(requests);
+}
+
+// ------
+
+FilteredTraceReader::FilteredTraceReader(std::unique_ptr<TraceReader> reader,
+                                         const TraceFilter& filter)
+    : reader(std::move(reader)), filter(filter) { }
+
+size_t FilteredTraceReader::read(MemoryRequest* out, size_t max) {
+  // Rejected requests are compacted away in place. Keep reading until at least one is
+  // accepted, since returning 0 would end the trace
+  size_t n { 0 };
+  while (n == 0) {
+    const size_t read_now = reader->read(out, max);
+    if (read_now == 0) break;
+
+    const auto rejected = [&](const MemoryRequest& request) {
+      return !filter.accepts(request);
+    };
+    n = std::remove_if(out, out + read_now, rejected) - out;
+  }
+  return n;
+}
+
+void FilteredTraceReader::set_readahead(size_t requests) {
+  reader->set_readahead(requests);
+}
+
+// ------
+
+WarmupTraceReader::WarmupTraceReader(std::unique_ptr<TraceReader> reader, uint64_t warmup,
+                                     const TraceFilter& filter,
+                                     std::atomic<uint64_t>& warmup_length)
+    : reader(std::move(reader)), filter(filter), warmup_length(warmup_length),
+      warmup_left(warmup) {
+  warmup_length = warmup > 0 ? UNKNOWN_LENGTH : 0;
+}
+
+size_t WarmupTraceReader::read(MemoryRequest* out, size_t max) {
+  // As in FilteredTraceReader, keep reading until at least one request is accepted
+  size_t n { 0 };
+  while (n == 0) {
+    const bool in_warmup = warmup_left > 0;
+    const size_t read_now =
+        reader->read(out, in_warmup ? std::min<uint64_t>(max, warmup_left) : max);
+    if (read_now == 0) {
+      // The trace ended during the warm-up
+      if (in_warmup) warmup_length = warmup_accepted;
+      break;
+    }
+
+    const auto rejected = [&](const MemoryRequest& request) {
+      return !filter.accepts(request);
+    };
+    n = filter.empty() ? read_now : std::remove_if(out, out + read_now, rejected) - out;
+
+    if (in_warmup) {
+      warmup_left -= read_now;
+      warmup_accepted += n;
+      if (warmup_left == 0) warmup_length = warmup_accepted;
+    }
+  }
+  return n;
+}
+
+void WarmupTraceReader::set_readahead(size_t requests) {
+  reader->set_readahead(requests);
+}
+
+// ------
+
+SampledTraceReader::SampledTraceReader(std::unique_ptr<TraceReader> reader,
+                                       const SamplingConfig& config,
+                                       const std::atomic<uint64_t>* warmup_length)
+    : reader(std::move(reader)), schedule(config), warmup_length(warmup_length) { }
+
+size_t SampledTraceReader::read(MemoryRequest* out, size_t max) {
+  if (warmup_length && *warmup_length == WarmupTraceReader::UNKNOWN_LENGTH)
+    return reader->read(out, max);
+
+  if (remaining == 0) {
+    const auto interval = schedule.next();
+    if (reader->skip(interval.skip) < interval.skip) return 0;
+    remaining = interval.warm + interval.measure;
+  }
+
+  const size_t n = reader->read(out, std::min<uint64_t>(max, remaining));
+  remaining -= n;
+  return n;
+}
+
+void SampledTraceReader::set_readahead(size_t requests) {
+  reader->set_readahead(requests);
+}
+
+// ------
+
+MappedTextTraceReader::MappedTextTraceReader(const std::string& fname) : file(fname) {
+  file.advise(MADV_SEQUENTIAL);
+}
+
+size_t MappedTextTraceReader::read(MemoryRequest* out, size_t max) {
+  const char* const data = file.data();
+  const size_t start     = pos;
+
+  size_t n { 0 };
+  while (n < max && pos < file.size()) {
+    const void* eol  = std::memchr(data + pos, '\n', file.size() - pos);
+    const size_t end = eol ? static_cast<const char*>(eol) - data : file.size();
+    if (MemoryTraceTools::parse_text_line({ data + pos, end - pos }, out[n])) n++;
+    pos = std::min(end + 1, file.size());
+  }
+  if (n == 0) return 0;
+
+  // Lines vary in length, so the bytes to prefetch are estimated from the lines just read
+  const size_t ahead = readahead ? readahead : n;
+  file.advise(MADV_WILLNEED, pos, (pos - start) / n * ahead);
+  file.advise(MADV_DONTNEED, start, pos - start);
+
+  return n;
+}
+
+size_t MappedTextTraceReader::skip(size_t n) {
+  // Skipped lines are only checked for being blank, not parsed
+  const char* const data = file.data();
+  const size_t start     = pos;
+
+  size_t skipped { 0 };
+  while (skipped < n && pos < file.size()) {
+    const void* eol  = std::memchr(data + pos, '\n', file.size() - pos);
+    const size_t end = eol ? static_cast<const char*>(eol) - data : file.size();
+    if (std::string_view { data + pos, end - pos }.find_first_not_of(" \t\r,") !=
+        std::string_view::npos)
+      skipped++;
+    pos = std::min(end + 1, file.size());
+  }
+
+  file.advise(MADV_DONTNEED, start, pos - start);
+  return skipped;
+}
+
+// ------
+
+TextTraceReader::TextTraceReader(const std::string& fname)
+    : file(fname), tracefile(file) {
+  if (!file.is_open()) throw std::invalid_argument("Cannot open trace file: " + fname);
+}
+
+TextTraceReader::TextTraceReader(std::istream& tracefile) : tracefile(tracefile) { }
+
+size_t TextTraceReader::read(MemoryRequest* out, size_t max) {
+  size_t n { 0 };
+  while (n < max && std::getline(tracefile, line))
+    if (MemoryTraceTools::parse_text_line(line, out[n])) n++;
+
+  return n;
+}
+
+bool TextTraceReader::next(MemoryRequest& request, uint64_t& seq) {
+  while (std::getline(tracefile, line))
+    if (MemoryTraceTools::parse_text_line(line, request, seq)) return true;
+
+  return false;
+}
+
+size_t TextTraceReader::skip(size_t n) {
+  // Skipped lines are only checked for being blank, not parsed
+  size_t skipped { 0 };
+  while (skipped < n && std::getline(tracefile, line))
+    if (line.find_first_not_of(" \t\r,") != std::string::npos) skipped++;
+
+  return skipped;
+}
+
+// ------
+
+MergedTraceReader::MergedTraceReader(
+    std::vector<std::unique_ptr<TextTraceReader>> readers)
+    : readers(std::move(readers)) { }
+
+void MergedTraceReader::advance_(size_t source) {
+  Head head { 0, source, {} };
+  if (readers[source]->next(head.request, head.seq)) heads.push(head);
+}
+
+size_t MergedTraceReader::read(MemoryRequest* out, size_t max) {
+  // The first request of each trace is read lazily, so that it happens on the thread
+  // doing the reading
+  if (!started) {
+    for (size_t source = 0; source < readers.size(); source++) advance_(source);
+    started = true;
+  }
+
+  size_t n { 0 };
+  while (n < max && !heads.empty()) {
+    const Head head = heads.top();
+    heads.pop();
+    out[n++] = head.request;
+    advance_(head.source);
+  }
+  return n;
+}
+
+// ------
+
+StreamedBinaryTraceReader::StreamedBinaryTraceReader(const std::string& fname)
+    : file(fname, std::ios::binary) {
+  if (!file.is_open()) throw std::invalid_argument("Cannot open trace file: " + fname);
+}
+
+void StreamedBinaryTraceReader::read_header_() {
+  // v1 traces start with the record count where newer ones have the magic number. The
+  // count is not needed either way
+  BinaryTrace::Header header;
+  file.read(reinterpret_cast<char*>(&header), BinaryTrace::LEGACY_HEADER_SIZE);
+  if (!BinaryTrace::has_magic(header.magic, file.gcount())) return;
+
+  file.read(reinterpret_cast<char*>(&header) + BinaryTrace::LEGACY_HEADER_SIZE,
+            sizeof(BinaryTrace::Header) - BinaryTrace::LEGACY_HEADER_SIZE);
+  if (!file) throw std::invalid_argument("Binary trace header is truncated");
+  BinaryTrace::check_header(header);
+  file.ignore(header.header_size - sizeof(BinaryTrace::Header));
+}
+
+size_t StreamedBinaryTraceReader::read(MemoryRequest* out, size_t max) {
+  if (!started) {
+    read_header_();
+    started = true;
+  }
+
+  buffer.resize(max * BinaryTrace::RECORD_SIZE);
+  file.read(buffer.data(), buffer.size());
+
+  const size_t bytes = file.gcount();
+  if (bytes % BinaryTrace::RECORD_SIZE != 0)
+    throw std::invalid_argument("Binary trace ends with a partial record");
+
+  const size_t n = bytes / BinaryTrace::RECORD_SIZE;
+  for (size_t i = 0; i < n; i++)
+    out[i] = BinaryTrace::decode(buffer.data() + i * BinaryTrace::RECORD_SIZE);
+  return n;
+}
+
+// ------
+
+ShmTraceReader::ShmTraceReader(const std::string& fname, uint64_t capacity)
+    : ring(fname, capacity) { }
+
+size_t ShmTraceReader::read(MemoryRequest* out, size_t max) {
+  return max == 0 ? 0 : ring.read(out, max);
+}
+
+// ------
+
+BinaryTraceReader::BinaryTraceReader(const std::string& fname) : trace(fname) { }
+
+size_t BinaryTraceReader::read(MemoryRequest* out, size_t max) {
+  const size_t n = std::min(max, trace.size() - next);
+  if (n == 0) return 0;
+
+  // Start reading the next chunk in while this one is decoded
+  trace.willneed(next + n, readahead ? readahead : n);
+
+  for (size_t i = 0; i < n; i++) out[i] = trace[next + i];
+
+  // Decoded records are never read again, so drop them from this process' working set.
+  // The pages stay in the page cache for other readers.
+  trace.dontneed(next, n);
+
+  next += n;
+  return n;
+}
+
+size_t BinaryTraceReader::skip(size_t n) {
+  n = std::min(n, trace.size() - next);
+  next += n;
+  return n;
+}
+
+// ------
+
+CompressedTraceReader::CompressedTraceReader(const std::string& fname) : trace(fname) { }
+
+size_t CompressedTraceReader::read(MemoryRequest* out, size_t max) {
+  const auto& decoder = trace.getDecoder();
+
+  size_t n { 0 };
+  while (n < max) {
+    if (block_pos == block.size()) {
+      if (next_block == decoder.nblocks()) break;
+
+      // Read the following blocks in while this one is decoded
+      if (next_block + 1 < decoder.nblocks()) {
+        const uint64_t ahead = std::clamp<uint64_t>(
+            readahead / decoder.block_records(next_block), 1,
+            decoder.nblocks() - next_block - 1);
+        trace.willneed(next_block + 1, ahead);
+      }
+
+      block.resize(decoder.block_records(next_block));
+      decoder.decode_block(next_block, block.data());
+      trace.dontneed(next_block, 1);
+
+      next_block++;
+      block_pos = 0;
+    }
+
+    const size_t count = std::min(max - n, block.size() - block_pos);
+    std::copy_n(block.begin() + block_pos, count, out + n);
+    block_pos += count;
+    n += count;
+  }
+
+  return n;
+}
+
+size_t CompressedTraceReader::skip(size_t n) {
+  const auto& decoder = trace.getDecoder();
+
+  // Skip what's left of the current block first
+  size_t skipped = std::min(n, block.size() - block_pos);
+  block_pos += skipped;
+  if (skipped == n || next_block == decoder.nblocks()) return skipped;
+
+  // Then seek straight to the block holding the next request to read, without decoding
+  // any of the blocks in between
+  const uint64_t start  = decoder.block_first(next_block);
+  const uint64_t target = std::min<uint64_t>(start + (n - skipped), decoder.size());
+  skipped += target - start;
+
+  if (target == decoder.size()) {
+    next_block = decoder.nblocks();
+    return skipped;
+  }
+
+  next_block = decoder.find_block(target);
+  block.resize(decoder.block_records(next_block));
+  decoder.decode_block(next_block, block.data());
+  block_pos = target - decoder.block_first(next_block);
+  next_block++;
+
+  return skipped;
+}
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "BinaryTrace.hh"
+#include "CompressedTrace.hh"
+#include "ForeignTrace.hh"
+#include "MappedFile.hh"
+#include "MemoryTrace.hh"
+#include "Sampling.hh"
+#include "ShmRing.hh"
+
+/* A source of memory requests that is consumed incrementally, so that a trace never has
+ * to be held in memory as a whole */
+class TraceReader {
+ protected:
+  /* How many requests past the last read to ask the kernel to prefetch. 0 prefetches as
+   * many requests as were just read */
+  size_t readahead { 0 };
+
+ private:
+  static std::unique_ptr<TraceReader> open_(const std::string& fname,
+                                            TraceFileType ftype);
+
+  /* Restrict a reader to a window of the trace, and to the requests accepted by
+   * `filter` */
+  static std::unique_ptr<TraceReader> restrict_(std::unique_ptr<TraceReader> reader,
+                                                size_t first, size_t count,
+                                                const TraceFilter& filter);
+
+ public:
+  virtual ~TraceReader();
+
+  /* Read up to `max` requests into `out`. Returns the number of requests read, which is
+   * only 0 once the end of the trace has been reached */
+  virtual size_t read(MemoryRequest* out, size_t max) = 0;
+
+  /* Skip over up to `n` requests. Returns the number of requests skipped. By default,
+   * requests are read and discarded, but readers that can seek override this */
+  virtual size_t skip(size_t n);
+
+  /* Set how many requests past the last read to prefetch, for readers of memory-mapped
+   * files. Prefetching hides read latency behind whatever the caller does between
+   * reads, which matters on high-latency filesystems. Readers that wrap another reader
+   * pass this on */
+  virtual void set_readahead(size_t requests);
+
+  /* Factory method for opening a trace file with the given encoding. Live inputs (see
+   * `MemoryTraceTools::is_live_input`) are read sequentially as data arrives.
+   * Only the window of `count` requests starting at request `first` is read, and only
+   * the requests in it accepted by `filter` are returned */
+  static std::unique_ptr<TraceReader> open(const std::string& fname, TraceFileType ftype,
+                                           size_t first = 0, size_t count = SIZE_MAX,
+                                           const TraceFilter& filter = {});
+
+  /* Open several traces of a multi-threaded run, merged into one stream ordered by
+   * sequence number (see `MergedTraceReader`). Only text traces record sequence numbers.
+   * The window and filter apply to the merged stream */
+  static std::unique_ptr<TraceReader> open(const std::vector<std::string>& fnames,
+                                           TraceFileType ftype, size_t first = 0,
+                                           size_t count = SIZE_MAX,
+                                           const TraceFilter& filter = {});
+};
+
+/* Returns only the requests from another reader that are accepted by a filter */
+class FilteredTraceReader : public TraceReader {
+  std::unique_ptr<TraceReader> reader;
+  const TraceFilter filter;
+
+ public:
+  FilteredTraceReader(std::unique_ptr<TraceReader> reader, const TraceFilter& filter);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual void set_readahead(size_t requests) override;
+};
+
+/* Reads the warm-up requests before a window of another reader, then the window, and
+ * returns only the requests accepted by a filter. How many warm-up requests the filter
+ * accepts is only known once all of them have been read, so it's published through
+ * `warmup_length`, which holds UNKNOWN_LENGTH until then. It's published before any
+ * request after the warm-up is returned, and no read returns requests from both sides */
+class WarmupTraceReader : public TraceReader {
+  std::unique_ptr<TraceReader> reader;
+  const TraceFilter filter;
+  std::atomic<uint64_t>& warmup_length;
+  uint64_t warmup_left, warmup_accepted { 0 };
+
+ public:
+  static constexpr uint64_t UNKNOWN_LENGTH = UINT64_MAX;
+
+  WarmupTraceReader(std::unique_ptr<TraceReader> reader, uint64_t warmup,
+                    const TraceFilter& filter, std::atomic<uint64_t>& warmup_length);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual void set_readahead(size_t requests) override;
+};
+
+/* Reads only the requests of a sampled trace that have to be simulated, skipping over the
+ * rest. If given a `warmup_length` (see `WarmupTraceReader`), requests are read as they
+ * are until it's known, as sampling only starts after the warm-up */
+class SampledTraceReader : public TraceReader {
+  std::unique_ptr<TraceReader> reader;
+  SampleSchedule schedule;
+  const std::atomic<uint64_t>* const warmup_length;
+  uint64_t remaining { 0 };
+
+ public:
+  SampledTraceReader(std::unique_ptr<TraceReader> reader, const SamplingConfig& config,
+                     const std::atomic<uint64_t>* warmup_length = nullptr);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual void set_readahead(size_t requests) override;
+};
+
+/* Reads a window of the requests from another reader */
+class WindowedTraceReader : public TraceReader {
+  std::unique_ptr<TraceReader> reader;
+  size_t first, remaining;
+  bool skipped { false };
+
+ public:
+  WindowedTraceReader(std::unique_ptr<TraceReader> reader, size_t first, size_t count);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual void set_readahead(size_t requests) override;
+};
+
+/* Reads a memory-mapped ArmIE text trace, parsing lines in place and releasing the pages
+ * it has already read */
+class MappedTextTraceReader : public TraceReader {
+  MappedFile file;
+  size_t pos { 0 };
+
+ public:
+  explicit MappedTextTraceReader(const std::string& fname);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual size_t skip(size_t n) override;
+};
+
+/* Reads an ArmIE text trace line by line, from a stream that cannot be memory-mapped */
+class TextTraceReader : public TraceReader {
+  std::ifstream file;
+  std::istream& tracefile;
+  std::string line;
+
+ public:
+  explicit TextTraceReader(const std::string& fname);
+  explicit TextTraceReader(std::istream& tracefile);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual size_t skip(size_t n) override;
+
+  /* Read the next request along with its sequence number. Returns false at the end of
+   * the trace */
+  bool next(MemoryRequest& request, uint64_t& seq);
+};
+
+/* Merges the per-thread text traces of a multi-threaded run into a single stream, ordered
+ * by sequence number. Each trace must already be in sequence order, as ArmIE writes them.
+ * Only the next request from each trace is held in memory. Requests with the same
+ * sequence number are returned in the order of their traces */
+class MergedTraceReader : public TraceReader {
+  std::vector<std::unique_ptr<TextTraceReader>> readers;
+
+  struct Head {
+    uint64_t seq;
+    size_t source;
+    MemoryRequest request;
+
+    bool operator>(const Head& other) const {
+      return seq != other.seq ? seq > other.seq : source > other.source;
+    }
+  };
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+  bool started { false };
+
+  void advance_(size_t source);
+
+ public:
+  explicit MergedTraceReader(std::vector<std::unique_ptr<TextTraceReader>> readers);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+};
+
+/* Reads a binary trace sequentially from a stream, such as a pipe, that cannot be
+ * memory-mapped. Records are read until the end of the stream, since a live producer
+ * cannot know the record count in advance */
+class StreamedBinaryTraceReader : public TraceReader {
+  std::ifstream file;
+  std::vector<char> buffer;
+  bool started { false };
+
+  void read_header_();
+
+ public:
+  explicit StreamedBinaryTraceReader(const std::string& fname);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+};
+
+/* Reads a trace written by another tool (see `ForeignTrace.hh`), decoding it as it's
+ * read. Works the same on files and on pipes */
+template <typename Reader>
+class ForeignTraceReader : public TraceReader {
+  std::ifstream file;
+  Reader reader;
+
+ public:
+  explicit ForeignTraceReader(const std::string& fname)
+      : file(fname, std::ios::binary), reader(file) {
+    if (!file.is_open()) throw std::invalid_argument("Cannot open trace file: " + fname);
+  }
+
+  virtual size_t read(MemoryRequest* out, size_t max) override {
+    return reader.read(out, max);
+  }
+};
+
+/* Reads requests live from a shared memory ring written by a tracing client (see
+ * `ShmRing`). The ring is created along with the reader, and the client can attach to
+ * it from then on. Reads wait until the client writes requests or closes the ring */
+class ShmTraceReader : public TraceReader {
+  ShmRing::Consumer ring;
+
+ public:
+  explicit ShmTraceReader(const std::string& fname,
+                          uint64_t capacity = ShmRing::DEFAULT_CAPACITY);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+};
+
+/* Reads a memory-mapped binary trace, releasing the pages it has already read */
+class BinaryTraceReader : public TraceReader {
+  MappedBinaryTrace trace;
+  size_t next { 0 };
+
+ public:
+  explicit BinaryTraceReader(const std::string& fname);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual size_t skip(size_t n) override;
+};
+
+/* Reads a memory-mapped compressed trace one block at a time */
+class CompressedTraceReader : public TraceReader {
+  MappedCompressedTrace trace;
+  uint64_t next_block { 0 };
+
+  /* The most recently decoded block, and how much of it has been returned */
+  std::vector<MemoryRequest> block;
+  size_t block_pos { 0 };
+
+ public:
+  explicit CompressedTraceReader(const std::string& fname);
+
+  virtual size_t read(MemoryRequest* out, size_t max) override;
+  virtual size_t skip(size_t n) override;
+};
@@ -0,0 +1,108 @@
+#include "TraceStream.hh"
+
+#include <stdexcept>
+
+TraceStream::TraceStream(std::unique_ptr<TraceReader> reader, int nconsumers,
+                         size_t chunk_size, size_t nchunks)
+    : reader(std::move(reader)),
+      ring(nchunks),
+      chunk_size(chunk_size),
+      nconsumers(nconsumers),
+      next_chunk(nconsumers, 0),
+      holding(nconsumers, false),
+      stalled(nconsumers, std::chrono::duration<double> { 0 }) {
+  if (nconsumers < 1) throw std::invalid_argument("Trace stream has no consumers");
+  if (chunk_size < 1 || nchunks < 1)
+    throw std::invalid_argument("Trace stream chunks must not be empty");
+
+  for (auto& chunk : ring) chunk.requests.reserve(chunk_size);
+
+  producer = std::thread { &TraceStream::produce_, this };
+}
+
+TraceStream::~TraceStream() {
+  {
+    std::lock_guard<std::mutex> lock { mutex };
+    stopping = true;
+  }
+  chunk_released.notify_all();
+  producer.join();
+}
+
+void TraceStream::produce_() {
+  try {
+    for (uint64_t seq = 0;; seq++) {
+      Chunk& chunk = ring[seq % ring.size()];
+
+      // Wait for every consumer to be done with the previous contents of this slot
+      {
+        std::unique_lock<std::mutex> lock { mutex };
+        chunk_released.wait(lock, [&] { return chunk.pending == 0 || stopping; });
+        if (stopping) break;
+      }
+
+      // The slot is not visible to consumers until it's published below, so it can be
+      // filled without holding the lock
+      const auto read_start = std::chrono::steady_clock::now();
+      chunk.requests.resize(chunk_size);
+      const size_t n = reader->read(chunk.requests.data(), chunk_size);
+      chunk.requests.resize(n);
+
+      std::lock_guard<std::mutex> lock { mutex };
+      reading += std::chrono::steady_clock::now() - read_start;
+      if (n == 0) {
+        finished = true;
+        break;
+      }
+      chunk.pending = nconsumers;
+      chunks_produced++;
+      requests_produced += n;
+      chunk_filled.notify_all();
+    }
+  } catch (...) {
+    std::lock_guard<std::mutex> lock { mutex };
+    error    = std::current_exception();
+    finished = true;
+  }
+
+  chunk_filled.notify_all();
+}
+
+const std::vector<MemoryRequest>* TraceStream::next(int consumer) {
+  std::unique_lock<std::mutex> lock { mutex };
+  uint64_t& seq = next_chunk.at(consumer);
+
+  // Release the chunk handed out on the previous call
+  if (holding[consumer]) {
+    Chunk& previous = ring[(seq - 1) % ring.size()];
+    if (--previous.pending == 0) chunk_released.notify_all();
+    holding[consumer] = false;
+  }
+
+  const auto available = [&] { return seq < chunks_produced || finished; };
+  if (!available()) {
+    const auto wait_start = std::chrono::steady_clock::now();
+    chunk_filled.wait(lock, available);
+    stalled[consumer] += std::chrono::steady_clock::now() - wait_start;
+  }
+  if (error) std::rethrow_exception(error);
+  if (seq >= chunks_produced) return nullptr;
+
+  holding[consumer] = true;
+  return &ring[seq++ % ring.size()].requests;
+}
+
+uint64_t TraceStream::getLength() {
+  std::lock_guard<std::mutex> lock { mutex };
+  return requests_produced;
+}
+
+double TraceStream::getStallTime(int consumer) {
+  std::lock_guard<std::mutex> lock { mutex };
+  return stalled.at(consumer).count();
+}
+
+double TraceStream::getReadTime() {
+  std::lock_guard<std::mutex> lock { mutex };
+  return reading.count();
+}
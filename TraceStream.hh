@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "MemoryTrace.hh"
+#include "TraceReader.hh"
+
+#define DEFAULT_STREAM_CHUNK_SIZE (1 << 16)
+#define DEFAULT_STREAM_CHUNKS     8
+
+/* Reads a trace on a background thread into a fixed-size ring of chunks. Every chunk is
+ * handed, in order, to each of a fixed number of consumers, and is only refilled once
+ * all of them have released it. Memory use is bounded by the ring size, regardless of
+ * the length of the trace */
+class TraceStream {
+  struct Chunk {
+    std::vector<MemoryRequest> requests;
+
+    /* The number of consumers that have yet to release this chunk */
+    int pending { 0 };
+  };
+
+  std::unique_ptr<TraceReader> reader;
+  std::vector<Chunk> ring;
+  const size_t chunk_size;
+  const int nconsumers;
+
+  /* The sequence number of the next chunk each consumer will read, and whether it still
+   * holds the one before it */
+  std::vector<uint64_t> next_chunk;
+  std::vector<bool> holding;
+
+  /* How long each consumer has waited for chunks to be read, and how long the producer
+   * has spent reading them */
+  std::vector<std::chrono::duration<double>> stalled;
+  std::chrono::duration<double> reading { 0 };
+
+  std::mutex mutex;
+  std::condition_variable chunk_filled, chunk_released;
+
+  uint64_t chunks_produced { 0 }, requests_produced { 0 };
+  bool finished { false }, stopping { false };
+  std::exception_ptr error;
+
+  std::thread producer;
+
+  void produce_();
+
+ public:
+  TraceStream(std::unique_ptr<TraceReader> reader, int nconsumers,
+              size_t chunk_size = DEFAULT_STREAM_CHUNK_SIZE,
+              size_t nchunks    = DEFAULT_STREAM_CHUNKS);
+  ~TraceStream();
+
+  TraceStream(const TraceStream&) = delete;
+  TraceStream& operator=(const TraceStream&) = delete;
+
+  /* Release the chunk previously returned to `consumer` and wait for the next one.
+   * Returns nullptr once the whole trace has been consumed. Rethrows any error raised
+   * while reading the trace */
+  const std::vector<MemoryRequest>* next(int consumer);
+
+  /* The number of requests read from the trace so far */
+  uint64_t getLength();
+
+  /* The time, in seconds, that `consumer` has spent waiting for the next chunk. This is
+   * the read latency that could not be hidden behind the consumer's own work */
+  double getStallTime(int consumer);
+
+  /* The time, in seconds, spent reading the trace on the background thread */
+  double getReadTime();
+};
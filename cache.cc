@@ -7,7 +7,7 @@
 #include "SetAssociativeCache.hh"
 
 static constexpr unsigned int nbits(const uint64_t n) {
-  return n == 1 ? 0 : 1 + nbits(n >> 1);
+  return n <= 1 ? 0 : 1 + nbits(n >> 1);
 }
 
 // ------
@@ -32,8 +32,8 @@ CacheAddress::CacheAddress(uint64_t address, uint64_t cache_size, int line_size,
 
   assert(index_bits < 62 && "Address index exceed 64-bit address space");
 
-  block = address & ((1 << block_bits) - 1);
-  index = (address >> block_bits) & ((1 << index_bits) - 1);
+  block = address & ((uint64_t { 1 } << block_bits) - 1);
+  index = (address >> block_bits) & ((uint64_t { 1 } << index_bits) - 1);
   tag   = address >> (block_bits + index_bits);
 }
 
@@ -41,7 +41,7 @@ CacheAddress::CacheAddress(uint64_t address, const CacheConfig& config)
     : CacheAddress(address, config.size, config.line_size, config.set_size) { }
 
 CacheAddress::CacheAddress(uint64_t address, const Cache& cache)
-    : CacheAddress(address, cache.getSize(), cache.getLineSize(), cache.getSetSize()) { }
+    : CacheAddress(cache.split_address(address)) { }
 
 // ------
 
@@ -56,13 +56,22 @@ void CacheEntry::set(uint64_t tag, uint64_t timestamp) {
 
 Cache::Cache(const uint64_t size, const int line_size, const int set_size,
              const std::shared_ptr<const Clock> clock)
-    : size(size), line_size(line_size), set_size(set_size), clock_(clock) {
+    : size(size),
+      line_size(line_size),
+      set_size(set_size),
+      block_bits(nbits(line_size)),
+      index_bits(nbits(size) - nbits(line_size) - nbits(set_size)),
+      block_mask((uint64_t { 1 } << block_bits) - 1),
+      index_mask((uint64_t { 1 } << index_bits) - 1),
+      clock_(clock) {
   if (size % line_size != 0)
     throw std::invalid_argument("Line size does not divide cache size");
   if (size % set_size != 0)
     throw std::invalid_argument("Set size does not divide cache size");
   if ((size & (size - 1)) != 0)
     throw std::invalid_argument("Cache size is not a power of 2");
+
+  assert(index_bits < 62 && "Address index exceed 64-bit address space");
 }
 
 Cache::Cache(const CacheConfig& config, const std::shared_ptr<const Clock> clock)
@@ -71,7 +80,7 @@ Cache::Cache(const CacheConfig& config, const std::shared_ptr<const Clock> clock
 Cache::~Cache() { }
 
 const CacheAddress Cache::split_address(const uint64_t address) const {
-  return CacheAddress(address, *this);
+  return split_line(line_of(address), block_of(address));
 }
 
 void Cache::log_eviction(uint64_t loaded_at) {
@@ -80,23 +89,27 @@ void Cache::log_eviction(uint64_t loaded_at) {
 
 CacheEvents Cache::touch(const uint64_t address, const int size) {
   CacheEvents events {};
-  uint64_t next_address { address };
+  uint64_t line { line_of(address) };
+  unsigned int block { block_of(address) };
   int remaining_size { size };
 
   while (remaining_size > 0) {
-    // Find the first cache line this request touches
-    auto const& cache_address = split_address(next_address);
-    events += touch(cache_address);
-
-    // Skip over the remaining bytes in this same cache line
-    const unsigned int covered_bytes = line_size - cache_address.block;
-    remaining_size -= covered_bytes;
-    next_address += covered_bytes;
+    events += touch(split_line(line, block));
+
+    // Skip over the remaining bytes in this same cache line, so the next one is touched
+    // from its start
+    remaining_size -= line_size - block;
+    line++;
+    block = 0;
   }
 
   return events;
 }
 
+void Cache::touch_repeated(const CacheAddress& address, uint64_t n) {
+  for (uint64_t i = 0; i < n; i++) touch(address);
+}
+
 CacheEvents Cache::touch(const SizedAccess& access) {
   return touch(access.address, access.size);
 }
@@ -138,6 +151,29 @@ uint64_t Cache::getMisses() const { return misses; }
 uint64_t Cache::getTotalAccesses() const { return hits + misses; }
 uint64_t Cache::getEvictions() const { return evictions; }
 
+void Cache::reset_stats() {
+  hits      = 0;
+  misses    = 0;
+  evictions = 0;
+  lifetimes.clear();
+}
+
+void Cache::pause_stats() {
+  std::swap(hits, paused_hits);
+  std::swap(misses, paused_misses);
+  std::swap(evictions, paused_evictions);
+  std::swap(lifetimes, paused_lifetimes);
+}
+
+void Cache::resume_stats() {
+  // Swap the counts made while paused out, then discard them
+  pause_stats();
+  paused_hits      = 0;
+  paused_misses    = 0;
+  paused_evictions = 0;
+  paused_lifetimes.clear();
+}
+
 std::unique_ptr<std::map<uint64_t, uint64_t>> Cache::getLifetimes() const {
   // The `lifetime` map only has data items already evicted, so make a copy and add data
   // for everything still in the cache
@@ -36,9 +36,10 @@ class Cache;
 
 /* A memory address split into the cache indexing components */
 struct CacheAddress {
-  uint64_t tag;
-  unsigned int index, block;
+  uint64_t tag, index;
+  unsigned int block;
 
+  CacheAddress() = default;
   explicit CacheAddress(uint64_t address, uint64_t cache_size, int line_size,
                         int set_size);
   explicit CacheAddress(uint64_t address, const CacheConfig& config);
@@ -102,6 +103,11 @@ class Cache {
   /* The size of a cache set, i.e. the "number of ways" */
   const int set_size;
 
+  /* The low bits of an address that pick a byte within its line, and the bits above
+   * those that pick the set. Worked out once, as every touch needs them */
+  const unsigned int block_bits, index_bits;
+  const uint64_t block_mask, index_mask;
+
   uint64_t hits { 0 }, misses { 0 }, evictions { 0 };
 
   /* The hierarchy's clock, shared between all the levels */
@@ -110,6 +116,10 @@ class Cache {
   /* A histogram of how long cache lines last in this cache before being evicted */
   std::map<uint64_t, uint64_t> lifetimes;
 
+  /* The stats put aside by `pause_stats` */
+  uint64_t paused_hits { 0 }, paused_misses { 0 }, paused_evictions { 0 };
+  std::map<uint64_t, uint64_t> paused_lifetimes;
+
 
   explicit Cache(const uint64_t size, const int line_size, const int set_size,
                  const std::shared_ptr<const Clock> clock);
@@ -153,6 +163,10 @@ class Cache {
   /* Run a sequence of requests through the cache */
   virtual CacheEvents touch(const std::vector<MemoryRequest>& requests) final;
 
+  /* Account for `n` more touches of a line that was just touched, and so is known to be
+   * cached. The clock must already show the cycle of the last of these touches */
+  virtual void touch_repeated(const CacheAddress& address, uint64_t n);
+
 
   virtual uint64_t getSize() const final;
   virtual int getLineSize() const final;
@@ -165,6 +179,15 @@ class Cache {
   uint64_t getEvictions() const;
   virtual std::unique_ptr<std::map<uint64_t, uint64_t>> getLifetimes() const final;
 
+  /* Clear the hit, miss, and eviction counts and the lifetimes histogram, keeping the
+   * contents of the cache */
+  void reset_stats();
+
+  /* Put the stats aside, so that the following touches update the contents of the cache
+   * without being counted, until `resume_stats` restores them. Both take constant time */
+  void pause_stats();
+  void resume_stats();
+
 
   /* Factory method for creating caches based on the given configuration */
   static std::unique_ptr<Cache> make_cache(const CacheConfig& config,
@@ -173,4 +196,33 @@ class Cache {
   /* Split a raw address into a tag, a set, a line, and a block, as mapped by this cache
    */
   virtual const CacheAddress split_address(const uint64_t address) const final;
+
+  /* The number of the line holding an address, counting lines from address 0, and the
+   * offset of the address in that line */
+  uint64_t line_of(const uint64_t address) const;
+  unsigned int block_of(const uint64_t address) const;
+
+  /* Split a line number from `line_of` into a tag and a set, as mapped by this cache,
+   * for an access `block` bytes into the line. Caches with lines of the same size can
+   * share one line number */
+  const CacheAddress split_line(const uint64_t line, const unsigned int block) const;
 };
+
+// These are run for every touch of every level, so they're kept where they can be inlined
+
+inline uint64_t Cache::line_of(const uint64_t address) const {
+  return address >> block_bits;
+}
+
+inline unsigned int Cache::block_of(const uint64_t address) const {
+  return static_cast<unsigned int>(address & block_mask);
+}
+
+inline const CacheAddress Cache::split_line(const uint64_t line,
+                                            const unsigned int block) const {
+  CacheAddress address;
+  address.tag   = line >> index_bits;
+  address.index = line & index_mask;
+  address.block = block;
+  return address;
+}
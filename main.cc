@@ -1,22 +1,34 @@
 #include <algorithm>
+#include <atomic>
 #include <bitset>
 #include <chrono>
+#include <cinttypes>
+#include <csignal>
+#include <cstdio>
 #include <cstring>
+#include <exception>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
-#include <set>
+#include <mutex>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <thread>
 
 #include <getopt.h>
 
+#include "BinaryTrace.hh"
 #include "CacheConfig.hh"
 #include "CacheHierarchy.hh"
+#include "CompressedTrace.hh"
 #include "DirectMappedCache.hh"
 #include "InfiniteCache.hh"
 #include "MemoryTrace.hh"
+#include "Sampling.hh"
 #include "SetAssociativeCache.hh"
+#include "ShmRing.hh"
+#include "TraceStream.hh"
 
 namespace {
 
@@ -30,6 +42,34 @@ namespace {
 
 #define OPT_ENCODING_TEXT   1
 #define OPT_ENCODING_BINARY 2
+#define OPT_STREAM_CHUNK    3
+#define OPT_STREAM_CHUNKS   4
+#define OPT_SKIP            5
+#define OPT_COUNT           6
+#define OPT_WARMUP          7
+#define OPT_FILTER_TID      8
+#define OPT_FILTER_PC       9
+#define OPT_FILTER_ADDRESS  10
+#define OPT_FILTER_READS    11
+#define OPT_FILTER_WRITES   12
+#define OPT_FILTER_BUNDLES  13
+#define OPT_FILTER_SCALARS  14
+#define OPT_COMPACT_RUNS    15
+#define OPT_READAHEAD       16
+#define OPT_SAMPLE          17
+#define OPT_SAMPLE_RANDOM   18
+#define OPT_SAMPLE_WARMING  19
+#define OPT_SAMPLE_SEED     20
+#define OPT_COMPRESS_MEMORY 21
+#define OPT_ENCODING_LACKEY 22
+#define OPT_ENCODING_DRCSIM 23
+
+/* The number of requests compacted into runs at a time */
+#define COMPACT_BLOCK_SIZE (1 << 16)
+
+/* The number of requests in each block of a trace compressed in memory. Each simulation
+ * decodes one block at a time, so blocks should fit in its core's cache */
+#define IN_MEMORY_BLOCK_SIZE (1 << 12)
 
 #define OPT_DEFAULT_LIFETIMES_FNAME "lifetimes.csv"
 #define OPT_DEFAULT_BUNDLES_FNAME   "bundles.csv"
@@ -45,6 +85,12 @@ enum OutputFormatBits {
 
 using OutputFormat = std::bitset<OUTPUT_BIT_COUNT>;
 
+/* Incremented by SIGUSR1 to ask streamed simulations to print their results so far */
+std::atomic<int> interim_requests { 0 };
+static_assert(ATOMIC_INT_LOCK_FREE == 2, "Signal handlers need lock-free atomics");
+
+void request_interim_results(int) { interim_requests++; }
+
 class CommaNumPunct : public std::numpunct<char> {
  protected:
   virtual char do_thousands_sep() const { return ','; }
@@ -55,9 +101,19 @@ void usage(int code) {
   // clang-format off
   std::cout << "Usage:\n";
   std::cout << "  scs --binary [OPTIONS] -c CONFIG-FILE TRACE-FILE\n";
-  std::cout << "  scs --text   [OPTIONS] -c CONFIG-FILE TRACE-FILE\n";
+  std::cout << "  scs --text   [OPTIONS] -c CONFIG-FILE TRACE-FILE...\n";
+  std::cout << "  scs {--lackey | --drcachesim} [OPTIONS] -c CONFIG-FILE TRACE-FILE\n";
   std::cout << "  scs --help\n";
   std::cout << "            \n";
+  std::cout << "TRACE-FILE may be `-` for stdin, or a named pipe. These are always streamed, and are\n";
+  std::cout << "read as text unless --binary is given. Send SIGUSR1 to print interim results.\n";
+  std::cout << "Valgrind Lackey output (--lackey) and DynamoRIO drcachesim traces (--drcachesim) are\n";
+  std::cout << "imported as they are read, and are guessed like the other encodings when not given.\n";
+  std::cout << "Several text TRACE-FILEs, one per thread of a run, are merged by sequence number and streamed.\n";
+  std::cout << "TRACE-FILE may also be `shm:NAME`, which creates a shared memory ring that a tracing\n";
+  std::cout << "client (such as `shm-producer`) writes requests to. Rings are streamed too.\n";
+  std::cout << "A ring left behind by a killed run must be removed first, with `rm /dev/shm/NAME`.\n";
+  std::cout << "            \n";
   std::cout << "Options:\n";
   std::cout << "  -b, --batch BATCH-FILE        Treat all entries in BATCH-FILE as arguments to -c\n";
   std::cout << "                                Paths are relative to the batch file. May be specified more than once.\n";
@@ -65,8 +121,38 @@ void usage(int code) {
   std::cout << "                                May be specified more than once for batch runs.\n";
   std::cout << "  -p, --io-threads N            Set the number of threads used for reading binary trace files.\n";
   std::cout << "                                Capped at `ncpus`. Default: min(" << DEFAULT_IO_THREADS << ", `ncpus`).\n";
-  std::cout << "  -f, --format {text,csv,both}  Set the output format. Default: 'both' for single runs, 'csv' for batches.\n\n";
+  std::cout << "  -f, --format {text,csv,both}  Set the output format. Default: 'both' for single runs, 'csv' for batches.\n";
   std::cout << "  -t, --timings                 Report run times of the main stages.\n";
+  std::cout << "  -s, --stream                  Simulate the trace while it is being read, without loading it whole.\n";
+  std::cout << "                                Memory use is bounded by the size of the chunk ring.\n";
+  std::cout << "      --chunk-size N            Set the number of requests per streamed chunk. Default: " << DEFAULT_STREAM_CHUNK_SIZE << ".\n";
+  std::cout << "      --chunks N                Set the number of chunks in the stream ring. Default: " << DEFAULT_STREAM_CHUNKS << ".\n";
+  std::cout << "      --readahead N             Ask the kernel to prefetch N requests past each streamed chunk. Default: one chunk.\n\n";
+  std::cout << "Trace Window (counted before any filtering):\n";
+  std::cout << "      --skip N                  Skip the first N requests of the trace. Binary traces seek straight past them.\n";
+  std::cout << "      --count N                 Simulate at most N requests after the skipped ones. Default: all.\n";
+  std::cout << "      --warmup N                Run the last N skipped requests through the caches first, without\n";
+  std::cout << "                                counting them in the results. At most the --skip count. Default: 0.\n\n";
+  std::cout << "Trace Filters (requests rejected by a filter are dropped as the trace is read):\n";
+  std::cout << "      --tid N                   Only keep requests from thread N.\n";
+  std::cout << "      --pc-range LO:HI          Only keep requests with LO <= PC <= HI.\n";
+  std::cout << "      --address-range LO:HI     Only keep requests with LO <= address <= HI.\n";
+  std::cout << "      --reads-only              Only keep reads.\n";
+  std::cout << "      --writes-only             Only keep writes.\n";
+  std::cout << "      --bundles-only            Only keep requests that are part of scatter/gather bundles.\n";
+  std::cout << "      --no-bundles              Only keep requests that are not part of bundles.\n\n";
+  std::cout << "Sampling (results also report 95% confidence intervals for miss rates):\n";
+  std::cout << "      --sample K/N              Only count K requests out of every N, taken from the end of each period.\n";
+  std::cout << "      --sample-random           Take each sample from a random position in its period instead.\n";
+  std::cout << "      --sample-warming W        Only warm the caches with the W requests before each sample, and skip\n";
+  std::cout << "                                the rest without simulating them. Default: warm with all of them.\n";
+  std::cout << "      --sample-seed S           Set the seed for random sample positions. Default: 0.\n\n";
+  std::cout << "Performance Options:\n";
+  std::cout << "      --compact-runs            Collapse consecutive accesses to the same L1 line into one lookup.\n";
+  std::cout << "                                Results are unchanged, but traces with a lot of locality run faster.\n";
+  std::cout << "      --compress-in-memory      Keep the loaded trace compressed in memory, and have each configuration\n";
+  std::cout << "                                decode it as it runs. Saves memory and bandwidth with many configurations.\n";
+  std::cout << "                                Streamed traces are never loaded, so they can't be compressed.\n";
   std::cout << "                                \n";
   std::cout << "Additional Experiment Options:\n";
   std::cout << "  -d, --save-lifetimes          Save a CSV histogram of cache line lifetimes (\"evict distance\").\n";
@@ -76,13 +162,29 @@ void usage(int code) {
   std::exit(code);
 }
 
+/* Parse an inclusive range of the form `LO:HI`. Numbers may be in hex with a 0x prefix */
+bool parse_range(const std::string& arg, uint64_t& lo, uint64_t& hi) {
+  const auto colon = arg.find(':');
+  if (colon == std::string::npos) return false;
+
+  try {
+    lo = std::stoull(arg.substr(0, colon), nullptr, 0);
+    hi = std::stoull(arg.substr(colon + 1), nullptr, 0);
+  } catch (const std::exception& e) {
+    return false;
+  }
+  return lo <= hi;
+}
+
 }  // namespace
 
 std::string config_name_from_fname(std::string_view fname);
-void print_text_results(const CacheHierarchy& cache, const MemoryTrace& trace,
-                        std::string_view config_fname);
-std::string make_csv_header();
-std::string make_csv_results(const CacheHierarchy& cache, std::string_view config_name);
+void print_text_results(const CacheHierarchy& cache, uint64_t trace_length,
+                        std::string_view config_fname,
+                        const SampleStats* samples = nullptr);
+std::string make_csv_header(bool sampled = false);
+std::string make_csv_results(const CacheHierarchy& cache, std::string_view config_name,
+                             const SampleStats* samples = nullptr);
 std::string make_csv_lifetimes_header();
 std::string make_csv_lifetimes(const CacheHierarchy& cache,
                                const std::string& config_name);
@@ -95,6 +197,16 @@ struct SimulationStats {
   std::shared_ptr<CacheHierarchy> cache;
 
   timestamp sim_start, sim_end;
+
+  /* Time spent waiting for the trace to be read, when streaming */
+  double io_stall { 0 };
+
+  /* Decides which requests are simulated and counted, when sampling */
+  std::optional<Sampler> sampler;
+
+  /* Whether the stats have been reset at the end of the warm-up */
+  bool warmed_up { false };
+
   std::string csv_results, csv_lifetimes, csv_bundles;
 
   SimulationStats(const std::string& sim_name,
@@ -108,15 +220,23 @@ struct SimulationStats {
 };
 
 void print_timings(timestamp start, timestamp parse_end,
-                   const std::vector<SimulationStats>& simulations, timestamp finish);
+                   const std::vector<SimulationStats>& simulations, timestamp finish,
+                   bool streamed, double stream_read_time);
 
 
 int main(int argc, char* argv[]) {
   int opt, int_optarg;
   std::vector<std::string> config_fnames, batch_names;
   bool encoding_provided { false }, enable_timing { false }, opt_f_used { false },
-      save_lifetimes { false }, save_bundles { false };
+      save_lifetimes { false }, save_bundles { false }, stream { false },
+      compact { false }, compress_in_memory { false };
   int io_threads { DEFAULT_IO_THREADS };
+  size_t stream_chunk_size { DEFAULT_STREAM_CHUNK_SIZE },
+      stream_chunks { DEFAULT_STREAM_CHUNKS }, readahead { 0 };
+  uint64_t skip { 0 }, count { SIZE_MAX }, warmup { 0 };
+  TraceFilter filter;
+  SamplingConfig sampling;
+  bool sample_random { false };
   TraceFileType trace_encoding {};
   OutputFormat output_format { (1 << OUTPUT_BIT_COUNT) - 1 };
 
@@ -124,15 +244,50 @@ int main(int argc, char* argv[]) {
                                    { "batch", required_argument, NULL, 'b' },
                                    { "text", no_argument, NULL, OPT_ENCODING_TEXT },
                                    { "binary", no_argument, NULL, OPT_ENCODING_BINARY },
+                                   { "lackey", no_argument, NULL, OPT_ENCODING_LACKEY },
+                                   { "drcachesim", no_argument, NULL,
+                                     OPT_ENCODING_DRCSIM },
                                    { "io-threads", required_argument, NULL, 'p' },
                                    { "format", required_argument, NULL, 'f' },
+                                   { "stream", no_argument, NULL, 's' },
+                                   { "chunk-size", required_argument, NULL,
+                                     OPT_STREAM_CHUNK },
+                                   { "chunks", required_argument, NULL,
+                                     OPT_STREAM_CHUNKS },
+                                   { "readahead", required_argument, NULL,
+                                     OPT_READAHEAD },
+                                   { "skip", required_argument, NULL, OPT_SKIP },
+                                   { "count", required_argument, NULL, OPT_COUNT },
+                                   { "warmup", required_argument, NULL, OPT_WARMUP },
+                                   { "tid", required_argument, NULL, OPT_FILTER_TID },
+                                   { "pc-range", required_argument, NULL, OPT_FILTER_PC },
+                                   { "address-range", required_argument, NULL,
+                                     OPT_FILTER_ADDRESS },
+                                   { "reads-only", no_argument, NULL, OPT_FILTER_READS },
+                                   { "writes-only", no_argument, NULL,
+                                     OPT_FILTER_WRITES },
+                                   { "bundles-only", no_argument, NULL,
+                                     OPT_FILTER_BUNDLES },
+                                   { "no-bundles", no_argument, NULL,
+                                     OPT_FILTER_SCALARS },
+                                   { "sample", required_argument, NULL, OPT_SAMPLE },
+                                   { "sample-random", no_argument, NULL,
+                                     OPT_SAMPLE_RANDOM },
+                                   { "sample-warming", required_argument, NULL,
+                                     OPT_SAMPLE_WARMING },
+                                   { "sample-seed", required_argument, NULL,
+                                     OPT_SAMPLE_SEED },
+                                   { "compact-runs", no_argument, NULL,
+                                     OPT_COMPACT_RUNS },
+                                   { "compress-in-memory", no_argument, NULL,
+                                     OPT_COMPRESS_MEMORY },
                                    { "timings", no_argument, NULL, 't' },
                                    { "save-lifetimes", no_argument, NULL, 'd' },
                                    { "save-bundles", no_argument, NULL, 'l' },
                                    { "help", no_argument, NULL, 'h' },
                                    { 0, 0, 0, 0 } };
 
-  while ((opt = getopt_long(argc, argv, "c:b:p:f:tdlh", long_options, NULL)) != -1) {
+  while ((opt = getopt_long(argc, argv, "c:b:p:f:stdlh", long_options, NULL)) != -1) {
     switch (opt) {
       // Config options
       case 'c':
@@ -153,6 +308,16 @@ int main(int argc, char* argv[]) {
         encoding_provided = true;
         trace_encoding    = TraceFileType::Binary;
         break;
+      case OPT_ENCODING_LACKEY:
+        if (encoding_provided) usage(EXIT_INVALID_ARGUMENTS);
+        encoding_provided = true;
+        trace_encoding    = TraceFileType::Lackey;
+        break;
+      case OPT_ENCODING_DRCSIM:
+        if (encoding_provided) usage(EXIT_INVALID_ARGUMENTS);
+        encoding_provided = true;
+        trace_encoding    = TraceFileType::DrCacheSim;
+        break;
 
       // Tunables
       case 'p':
@@ -160,6 +325,86 @@ int main(int argc, char* argv[]) {
         if (int_optarg < 1) usage(EXIT_INVALID_ARGUMENTS);
         io_threads = int_optarg;
         break;
+      case 's':
+        stream = true;
+        break;
+      case OPT_STREAM_CHUNK:
+        int_optarg = std::stoi(optarg);
+        if (int_optarg < 1) usage(EXIT_INVALID_ARGUMENTS);
+        stream_chunk_size = int_optarg;
+        break;
+      case OPT_STREAM_CHUNKS:
+        int_optarg = std::stoi(optarg);
+        if (int_optarg < 1) usage(EXIT_INVALID_ARGUMENTS);
+        stream_chunks = int_optarg;
+        break;
+      case OPT_READAHEAD:
+        int_optarg = std::stoi(optarg);
+        if (int_optarg < 1) usage(EXIT_INVALID_ARGUMENTS);
+        readahead = int_optarg;
+        break;
+
+      // Trace window options
+      case OPT_SKIP:
+        skip = std::stoull(optarg);
+        break;
+      case OPT_COUNT:
+        count = std::stoull(optarg);
+        break;
+      case OPT_WARMUP:
+        warmup = std::stoull(optarg);
+        break;
+
+      // Filter options
+      case OPT_FILTER_TID:
+        filter.tid = std::stoi(optarg);
+        break;
+      case OPT_FILTER_PC:
+        if (!parse_range(optarg, filter.pc_min, filter.pc_max))
+          usage(EXIT_INVALID_ARGUMENTS);
+        break;
+      case OPT_FILTER_ADDRESS:
+        if (!parse_range(optarg, filter.address_min, filter.address_max))
+          usage(EXIT_INVALID_ARGUMENTS);
+        break;
+      case OPT_FILTER_READS:
+        if (filter.is_write) usage(EXIT_INVALID_ARGUMENTS);
+        filter.is_write = false;
+        break;
+      case OPT_FILTER_WRITES:
+        if (filter.is_write) usage(EXIT_INVALID_ARGUMENTS);
+        filter.is_write = true;
+        break;
+      case OPT_FILTER_BUNDLES:
+        filter.bundle_kinds &= 0xfe;
+        break;
+      case OPT_FILTER_SCALARS:
+        filter.bundle_kinds &= 0x01;
+        break;
+
+      // Sampling options
+      case OPT_SAMPLE:
+        if (std::sscanf(optarg, "%" SCNu64 "/%" SCNu64, &sampling.sample_size,
+                        &sampling.period) != 2 ||
+            sampling.sample_size == 0 || sampling.sample_size > sampling.period)
+          usage(EXIT_INVALID_ARGUMENTS);
+        break;
+      case OPT_SAMPLE_RANDOM:
+        sample_random = true;
+        break;
+      case OPT_SAMPLE_WARMING:
+        sampling.warming = std::stoull(optarg);
+        break;
+      case OPT_SAMPLE_SEED:
+        sampling.seed = std::stoull(optarg);
+        break;
+
+      case OPT_COMPACT_RUNS:
+        compact = true;
+        break;
+      case OPT_COMPRESS_MEMORY:
+        compress_in_memory = true;
+        break;
 
       // Output options
       case 'f':
@@ -213,49 +458,169 @@ int main(int argc, char* argv[]) {
   }
   if (config_fnames.empty() || argc < 1) usage(EXIT_INVALID_ARGUMENTS);
 
+  if (sampling.period > 0)
+    sampling.mode = sample_random ? SamplingMode::Random : SamplingMode::Periodic;
+  else if (sample_random)
+    usage(EXIT_INVALID_ARGUMENTS);
+
+  // Warm-up requests are taken from the skipped ones, so there must be enough of them
+  if (warmup > skip) usage(EXIT_INVALID_ARGUMENTS);
+
   // In batch mode, if text output hasn't been request specifically, use CSV output by
   // default
   if (config_fnames.size() > 1 && !opt_f_used) output_format.reset(BIT_OUTPUT_TEXT);
 
   std::ostringstream info_output;
 
-  const std::string trace_fname { argv[0] };
-  if (!encoding_provided) try {
+  const std::vector<std::string> trace_fnames(argv, argv + argc);
+  const std::string& trace_fname = trace_fnames[0];
+
+  // Per-thread traces are merged as they are read, so they're always streamed
+  const bool merged = trace_fnames.size() > 1;
+  if (merged) stream = true;
+
+  // Live traces can only be read once, so they can't be sniffed or loaded whole
+  const bool live = MemoryTraceTools::is_live_input(trace_fname);
+  const bool ring = ShmRing::is_ring_name(trace_fname);
+  if (live) {
+    stream = true;
+    if (!encoding_provided) trace_encoding = TraceFileType::Text;
+  }
+
+  // Streamed traces are never held in memory whole, so there's nothing to compress
+  if (compress_in_memory && stream) {
+    std::cout << "--compress-in-memory can't be used with streamed traces\n";
+    std::exit(EXIT_INVALID_ARGUMENTS);
+  }
+
+  if (!encoding_provided && !live) try {
       trace_encoding = MemoryTraceTools::guess_file_type(argv[0]);
     } catch (const std::invalid_argument& e) {
       std::exit(EXIT_INVALID_TRACE);
     }
 
+  // Compressed traces are a kind of binary trace, so read them transparently
+  if (encoding_provided && !live && trace_encoding == TraceFileType::Binary) try {
+      trace_encoding = MemoryTraceTools::guess_file_type(trace_fname);
+    } catch (const std::invalid_argument& e) {
+      std::exit(EXIT_INVALID_TRACE);
+    }
+
+  // Rings hold requests as they are, so --text and --binary make no difference
+  if (ring) trace_encoding = TraceFileType::Binary;
+
   info_output << "Trace file encoding: ";
   switch (trace_encoding) {
     case TraceFileType::Text:
       info_output << "text";
       break;
     case TraceFileType::Binary:
-      info_output << "binary";
+      info_output << (ring ? "binary records from a shared memory ring" : "binary");
+      break;
+    case TraceFileType::Compressed:
+      info_output << "compressed binary";
+      break;
+    case TraceFileType::Lackey:
+      info_output << "Valgrind Lackey";
+      break;
+    case TraceFileType::DrCacheSim:
+      info_output << "DynamoRIO drcachesim";
       break;
     default:
       info_output << "unknown\n";
       std::exit(EXIT_UNKOWN_ENCODING);
   }
-  if (!encoding_provided) info_output << " (guessed)";
+  if (!encoding_provided && !ring) info_output << (live ? " (assumed)" : " (guessed)");
   info_output << "\n";
+  if (merged) {
+    if (std::any_of(trace_fnames.begin(), trace_fnames.end(), ShmRing::is_ring_name)) {
+      std::cout << "Shared memory rings can't be merged\n";
+      std::exit(EXIT_INVALID_ARGUMENTS);
+    }
+    if (trace_encoding != TraceFileType::Text) {
+      std::cout << "Only text traces can be merged by sequence number\n";
+      std::exit(EXIT_INVALID_ARGUMENTS);
+    }
+    info_output << "Merging " << trace_fnames.size() << " traces by sequence number\n";
+  }
 
   if (output_format[BIT_OUTPUT_TEXT]) std::cout << info_output.str();
 
+  const auto print_summary = [](const TraceSummary& summary) {
+    std::cout << "Trace has " << summary.record_count << " entries.\n";
+    std::cout << "Seen about " << summary.unique_addresses << " unique addresses, "
+              << summary.unique_lines_64 << " unique 64 B lines, and "
+              << summary.unique_lines_256 << " unique 256 B lines.\n";
+    std::cout << "Seen " << summary.bundle_count << " scatter/gather bundles.\n";
+    if (summary.record_count > 0)
+      std::cout << "Addresses range from 0x" << std::hex << summary.min_address << " to 0x"
+                << summary.max_address << std::dec << ".\n";
+  };
+
+  // Binary traces may carry a summary in their header, which saves a pass over the trace.
+  // It describes the whole trace, so it's only used when all of the trace is simulated
+  const bool whole_trace = skip == 0 && count == SIZE_MAX && filter.empty();
+  std::optional<TraceSummary> summary;
+  if (output_format[BIT_OUTPUT_TEXT] && !live && whole_trace &&
+      trace_encoding == TraceFileType::Binary) {
+    try {
+      summary = BinaryTrace::read_summary(trace_fname);
+    } catch (const std::invalid_argument& e) {
+      std::cout << e.what() << "\n";
+      std::exit(EXIT_INVALID_TRACE);
+    }
+    if (summary) print_summary(*summary);
+  }
+
+  // Only the warm-up requests and the window after them are ever read
+  const uint64_t load_first = skip - warmup;
+  const uint64_t load_count = count > SIZE_MAX - warmup ? SIZE_MAX : warmup + count;
+
+  // The number of warm-up requests the filter accepts. When streaming, it's only known
+  // once the reader has read past the warm-up (see `WarmupTraceReader`)
+  std::atomic<uint64_t> warmup_length { 0 };
+
   const timestamp t_start = std::chrono::high_resolution_clock::now();
 
-  MemoryTrace trace { trace_fname, trace_encoding, io_threads };
+  // In streaming mode, the trace is read while the simulations run. Otherwise, the
+  // warm-up is loaded apart from the window, so the filter can't move the boundary
+  std::unique_ptr<MemoryTrace> trace, warmup_trace;
+  if (!stream) try {
+      if (warmup > 0) {
+        warmup_trace  = std::make_unique<MemoryTrace>(trace_fname, trace_encoding,
+                                                      io_threads, load_first, warmup,
+                                                      filter);
+        warmup_length = warmup_trace->getLength();
+      }
+      trace = std::make_unique<MemoryTrace>(trace_fname, trace_encoding, io_threads, skip,
+                                            count, filter);
+    } catch (const std::exception& e) {
+      std::cout << e.what() << "\n";
+      std::exit(EXIT_INVALID_TRACE);
+    }
 
-  const timestamp t_parse_end = std::chrono::high_resolution_clock::now();
+  if (output_format[BIT_OUTPUT_TEXT] && !stream && !summary)
+    print_summary(trace->getSummary());
 
-  if (output_format[BIT_OUTPUT_TEXT]) {
-    const auto addresses = trace.getRequestAddresses();
-    std::set<uint64_t> unique_addresses(addresses.begin(), addresses.end());
-    std::cout << "Trace has " << trace.getLength() << " entries.\n";
-    std::cout << "Seen " << unique_addresses.size() << " unique addresses.\n";
+  // A compressed trace replaces the loaded one, which is freed straight away
+  std::unique_ptr<CompressedTraceBuffer> compressed_trace;
+  if (compress_in_memory) {
+    compressed_trace = std::make_unique<CompressedTraceBuffer>(trace->getRequests(),
+                                                               IN_MEMORY_BLOCK_SIZE);
+    trace.reset();
+
+    if (output_format[BIT_OUTPUT_TEXT])
+      std::cout << "Trace compressed in memory to " << std::fixed << std::setprecision(1)
+                << compressed_trace->bytes() / (1024.0 * 1024.0) << " MiB ("
+                << std::setprecision(2)
+                << static_cast<double>(compressed_trace->bytes()) /
+                       std::max<size_t>(compressed_trace->size(), 1)
+                << " bytes per request).\n"
+                << std::defaultfloat;
   }
 
+  const timestamp t_parse_end = std::chrono::high_resolution_clock::now();
+
   // Prepare a SmulationStats object to be populated as configurations are executed
   int max_levels = 0;
   std::vector<std::shared_ptr<CacheHierarchy>> caches;
@@ -278,30 +643,190 @@ int main(int argc, char* argv[]) {
   }
 
 
-  // Main simulation loop
-#pragma omp parallel for
-  for (size_t i = 0; i < simulation_stats.size(); i++) {
-    auto& sim = simulation_stats[i];
+  // Run requests through a simulation, compacting them into runs first if asked to. Runs
+  // are compacted a block at a time, so they never span blocks
+  const auto run_requests = [&](CacheHierarchy& cache, const auto& requests) {
+    if (!compact) {
+      cache.touch(requests);
+      return;
+    }
 
-    sim.sim_start = std::chrono::high_resolution_clock::now();
-    sim.cache->touch(trace.getRequests());
-    sim.sim_end = std::chrono::high_resolution_clock::now();
+    thread_local std::vector<RequestRun> runs;
+    const int line_size = cache.getLineSize(1);
+    for (size_t offset = 0; offset < requests.size(); offset += COMPACT_BLOCK_SIZE) {
+      const auto block = requests.subspan(offset, COMPACT_BLOCK_SIZE);
+      runs.clear();
+      MemoryTraceTools::compact_runs(block.begin(), block.end(), line_size, runs);
+      cache.touch(runs);
+    }
+  };
+
+  // Sampled simulations decide for themselves which requests to run and count. In
+  // streaming mode, the requests they would skip are never read
+  if (sampling.enabled())
+    for (auto& sim : simulation_stats) sim.sampler.emplace(sampling, stream);
+
+  // Run requests through a simulation that has already run `position` requests. Its
+  // stats are reset once all the warm-up requests have been run. While the warm-up length
+  // is unknown, every request read belongs to the warm-up
+  const auto simulate = [&](SimulationStats& sim, const auto& requests,
+                            uint64_t& position) {
+    CacheHierarchy& cache   = *sim.cache;
+    const uint64_t warm_end = warmup_length;
+    const auto warm = requests.subspan(0, warm_end - std::min(position, warm_end));
+    run_requests(cache, warm);
+    position += warm.size();
+    if (!sim.warmed_up && position == warm_end) {
+      cache.reset_stats();
+      sim.warmed_up = true;
+    }
+
+    const auto measured = requests.subspan(warm.size());
+    if (sim.sampler)
+      sim.sampler->run(cache, measured, run_requests);
+    else
+      run_requests(cache, measured);
+    position += measured.size();
+  };
+  const auto measured_length = [&](const SimulationStats& sim, uint64_t position) {
+    if (sim.sampler) return sim.sampler->getMeasured();
+    return position - std::min<uint64_t>(position, warmup_length);
+  };
+  const auto sample_stats = [](const SimulationStats& sim) -> const SampleStats* {
+    return sim.sampler ? &sim.sampler->getStats() : nullptr;
+  };
+
+  const auto collect_results = [&](SimulationStats& sim, uint64_t position) {
+    if (sim.sampler) sim.sampler->finish(*sim.cache);
+    // A trace that ends during the warm-up has nothing measured
+    if (!sim.warmed_up) sim.cache->reset_stats();
+    const uint64_t trace_length = measured_length(sim, position);
 
     if (output_format[BIT_OUTPUT_TEXT])
-      print_text_results(*sim.cache, trace, sim.sim_name);
+      print_text_results(*sim.cache, trace_length, sim.sim_name, sample_stats(sim));
 
     if (output_format[BIT_OUTPUT_CSV])
-      sim.csv_results = make_csv_results(*sim.cache, sim.sim_name);
+      sim.csv_results = make_csv_results(*sim.cache, sim.sim_name, sample_stats(sim));
 
     if (save_lifetimes) sim.csv_lifetimes = make_csv_lifetimes(*sim.cache, sim.sim_name);
     if (save_bundles) sim.csv_bundles = make_csv_bundles(*sim.cache, sim.sim_name);
+  };
+
+  // Main simulation loop
+  double stream_read_time { 0 };
+  if (stream) {
+    // Interim results are printed by each simulation between chunks, so they only ever
+    // see a consistent cache state
+    std::mutex interim_mutex;
+    const auto print_interim_results = [&](const SimulationStats& sim,
+                                           uint64_t position) {
+      std::lock_guard<std::mutex> lock { interim_mutex };
+      if (output_format[BIT_OUTPUT_TEXT])
+        print_text_results(*sim.cache, measured_length(sim, position),
+                           sim.sim_name + " (interim)", sample_stats(sim));
+      else
+        std::cout << make_csv_results(*sim.cache, sim.sim_name, sample_stats(sim))
+                  << std::flush;
+    };
+    std::signal(SIGUSR1, request_interim_results);
+
+    // Every configuration must consume each chunk before the ring can advance, so each
+    // one needs its own thread, regardless of the OpenMP thread count
+    std::unique_ptr<TraceReader> reader;
+    try {
+      reader = TraceReader::open(trace_fnames, trace_encoding, load_first, load_count,
+                                 warmup > 0 ? TraceFilter {} : filter);
+    } catch (const std::exception& e) {
+      std::cout << e.what() << "\n";
+      std::exit(EXIT_INVALID_TRACE);
+    }
+    if (warmup > 0)
+      reader = std::make_unique<WarmupTraceReader>(std::move(reader), warmup, filter,
+                                                   warmup_length);
+    reader->set_readahead(readahead);
+    if (sampling.enabled())
+      reader = std::make_unique<SampledTraceReader>(std::move(reader), sampling,
+                                                    &warmup_length);
+    TraceStream trace_stream { std::move(reader),
+                               static_cast<int>(simulation_stats.size()),
+                               stream_chunk_size, stream_chunks };
+
+    // Errors reading the trace reach every consumer. They're reported once all of them
+    // have stopped, as an exception can't leave a thread
+    std::vector<std::thread> consumers;
+    std::vector<std::exception_ptr> errors(simulation_stats.size());
+    consumers.reserve(simulation_stats.size());
+    for (size_t i = 0; i < simulation_stats.size(); i++) {
+      consumers.emplace_back([&, i]() {
+        auto& sim = simulation_stats[i];
+        uint64_t simulated { 0 };
+        int interim_seen = interim_requests;
+
+        try {
+          sim.sim_start = std::chrono::high_resolution_clock::now();
+          while (const auto chunk = trace_stream.next(i)) {
+            simulate(sim, Span<const MemoryRequest> { *chunk }, simulated);
+
+            if (interim_requests != interim_seen) {
+              interim_seen = interim_requests;
+              print_interim_results(sim, simulated);
+            }
+          }
+          sim.sim_end  = std::chrono::high_resolution_clock::now();
+          sim.io_stall = trace_stream.getStallTime(i);
+
+          collect_results(sim, simulated);
+        } catch (...) {
+          errors[i] = std::current_exception();
+        }
+      });
+    }
+    for (auto& t : consumers) t.join();
+
+    for (const auto& error : errors) {
+      if (!error) continue;
+      try {
+        std::rethrow_exception(error);
+      } catch (const std::exception& e) {
+        std::cout << e.what() << "\n";
+        std::exit(EXIT_INVALID_TRACE);
+      }
+    }
+    stream_read_time = trace_stream.getReadTime();
+
+    if (output_format[BIT_OUTPUT_TEXT])
+      std::cout << SEPARATOR "\n"
+                << "Trace had " << trace_stream.getLength() << " entries.\n";
+  } else {
+#pragma omp parallel for
+    for (size_t i = 0; i < simulation_stats.size(); i++) {
+      auto& sim = simulation_stats[i];
+
+      sim.sim_start = std::chrono::high_resolution_clock::now();
+      uint64_t simulated { 0 };
+      if (warmup_trace) simulate(sim, warmup_trace->getRequests(), simulated);
+      if (compressed_trace) {
+        // Each simulation decodes the blocks into its own small buffer as it goes
+        const auto& decoder = compressed_trace->getDecoder();
+        std::vector<MemoryRequest> block(decoder.block_size());
+        for (uint64_t b = 0; b < decoder.nblocks(); b++) {
+          const size_t n = decoder.decode_block(b, block.data());
+          simulate(sim, Span<const MemoryRequest> { block.data(), n }, simulated);
+        }
+      } else {
+        simulate(sim, trace->getRequests(), simulated);
+      }
+      sim.sim_end = std::chrono::high_resolution_clock::now();
+
+      collect_results(sim, simulated);
+    }
   }
 
 
   if (output_format[BIT_OUTPUT_CSV]) {
     if (output_format[BIT_OUTPUT_TEXT]) std::cout << SEPARATOR "\n";
 
-    std::cout << make_csv_header() << "\n";
+    std::cout << make_csv_header(sampling.enabled()) << "\n";
     for (const auto& sim : simulation_stats) std::cout << sim.csv_results;
   }
 
@@ -318,7 +843,9 @@ int main(int argc, char* argv[]) {
   }
 
   const auto t_finish = std::chrono::high_resolution_clock::now();
-  if (enable_timing) print_timings(t_start, t_parse_end, simulation_stats, t_finish);
+  if (enable_timing)
+    print_timings(t_start, t_parse_end, simulation_stats, t_finish, stream,
+                  stream_read_time);
 
   return 0;
 }
@@ -335,8 +862,8 @@ std::string config_name_from_fname(std::string_view fname) {
 }
 
 
-void print_text_results(const CacheHierarchy& cache, const MemoryTrace& trace,
-                        std::string_view config_fname) {
+void print_text_results(const CacheHierarchy& cache, uint64_t trace_length,
+                        std::string_view config_fname, const SampleStats* samples) {
   std::ostringstream ss;
 
   ss << SEPARATOR "\n";
@@ -361,6 +888,12 @@ void print_text_results(const CacheHierarchy& cache, const MemoryTrace& trace,
        << std::setprecision(2) << pct_hits << "%)\n";
     ss << level_names[level] << " Misses: " << misses << " (" << std::fixed
        << std::setprecision(2) << pct_misses << "%)\n";
+    if (samples) {
+      const auto [miss_rate, error] = samples->getMissRate(level);
+      ss << level_names[level] << " Sampled miss rate: " << std::fixed
+         << std::setprecision(2) << miss_rate * 100.0 << "% +/- " << error * 100.0
+         << "% (95% confidence, " << samples->size() << " samples)\n";
+    }
     ss << level_names[level] << " Evictions: " << evictions << "\n";
     ss << level_names[level] << " to " << level_names[level + 1]
        << " traffic: " << cache.getTraffic(level) << " bytes\n";
@@ -373,7 +906,7 @@ void print_text_results(const CacheHierarchy& cache, const MemoryTrace& trace,
     total_bundle_ops += b.second.total_ops;
   }
   const auto bundle_ratio =
-      static_cast<double>(total_bundle_ops) / trace.getLength() * 100;
+      static_cast<double>(total_bundle_ops) / trace_length * 100;
 
   ss << "\n";
   ss << "Total scatter/gather bundles simulated: " << total_bundles << "\n";
@@ -385,11 +918,13 @@ void print_text_results(const CacheHierarchy& cache, const MemoryTrace& trace,
   std::cout << ss.str();
 }
 
-std::string make_csv_header() {
-  return "config,level,accesses,misses,evictions,traffic-up";
+std::string make_csv_header(bool sampled) {
+  return std::string { "config,level,accesses,misses,evictions,traffic-up" } +
+         (sampled ? ",miss-rate,miss-rate-ci95" : "");
 }
 
-std::string make_csv_results(const CacheHierarchy& cache, std::string_view config_name) {
+std::string make_csv_results(const CacheHierarchy& cache, std::string_view config_name,
+                             const SampleStats* samples) {
   std::ostringstream csv;
 
   for (int level = 1; level <= cache.nlevels(); level++) {
@@ -399,7 +934,12 @@ std::string make_csv_results(const CacheHierarchy& cache, std::string_view confi
     const auto traffic_up = cache.getTraffic(level);
 
     csv << config_name << ',' << level << ',' << total << ',' << misses << ','
-        << evictions << ',' << traffic_up << '\n';
+        << evictions << ',' << traffic_up;
+    if (samples) {
+      const auto [miss_rate, error] = samples->getMissRate(level);
+      csv << ',' << miss_rate << ',' << error;
+    }
+    csv << '\n';
   }
 
   return csv.str();
@@ -407,17 +947,22 @@ std::string make_csv_results(const CacheHierarchy& cache, std::string_view confi
 
 void print_timings(timestamp start, timestamp parse_end,
                    const std::vector<SimulationStats>& simulation_stats,
-                   timestamp finish) {
+                   timestamp finish, bool streamed, double stream_read_time) {
   std::cout << SEPARATOR "\n" << std::setprecision(2);
 
   const auto total_time = std::chrono::duration<double>(finish - start).count();
   std::cout << "Simulated " << simulation_stats.size() << " configurations in "
             << total_time << " s\n";
 
-  const auto parse_time     = std::chrono::duration<double>(parse_end - start).count();
-  const auto parse_time_pct = (parse_time / total_time) * 100;
-  std::cout << "  Reading trace file took " << parse_time << " s (" << parse_time_pct
-            << "%)\n";
+  if (streamed)
+    std::cout << "  Reading trace file took " << stream_read_time
+              << " s, overlapped with simulation\n";
+  else {
+    const auto parse_time = std::chrono::duration<double>(parse_end - start).count();
+    const auto parse_time_pct = (parse_time / total_time) * 100;
+    std::cout << "  Reading trace file took " << parse_time << " s (" << parse_time_pct
+              << "%)\n";
+  }
 
   for (const auto& sim : simulation_stats) {
     const auto sim_time =
@@ -425,6 +970,9 @@ void print_timings(timestamp start, timestamp parse_end,
     const auto sim_time_pct = (sim_time / total_time) * 100;
     std::cout << "  Simulating " << sim.sim_name << " took " << sim_time << " s ("
               << sim_time_pct << "%)\n";
+    if (streamed)
+      std::cout << "    Stalled waiting for trace I/O for " << sim.io_stall << " s ("
+                << (sim.io_stall / sim_time) * 100 << "% of its run)\n";
   }
 }
 
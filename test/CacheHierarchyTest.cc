@@ -72,6 +72,24 @@ TEST_CASE("Second hierarchy touch always hits first level", "[hierarchy]") {
     REQUIRE(ch->getHits(level) == 0);
 }
 
+TEST_CASE("Resetting hierarchy stats keeps the cached lines", "[hierarchy][stats]") {
+  const auto ch = make_default_hierarchy(CacheType::SetAssociative);
+
+  const uint64_t address = GENERATE(take(DEFAULT_RANDOM_COUNT, random_addresses()));
+
+  ch->touch(address);  // all miss
+  ch->reset_stats();
+
+  for (int level = 0; level <= DEFAULT_HIERARCHY_SIZE; level++)
+    REQUIRE(ch->getTraffic(level) == 0);
+
+  ch->touch(address);  // hit on L1, since the line is still cached
+
+  REQUIRE(ch->getHits(1) == 1);
+  for (int level = 1; level <= DEFAULT_HIERARCHY_SIZE; level++)
+    REQUIRE(ch->getMisses(level) == 0);
+}
+
 TEST_CASE("Levels in a hierarchy hit and miss as expected", "[hierarchy]") {
   const int hierarchy_size { 3 };
   const int size_per_level { 1024 };
@@ -211,6 +229,79 @@ TEST_CASE("Bundles are counted correctly", "[hierarchy][stats][bundle]") {
   REQUIRE(bundles.at(0x40e200).total_ops == 6);
 }
 
+TEST_CASE("Request views and iterator ranges simulate the same as vectors",
+          "[hierarchy]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+  const auto requests = trace.getRequests();
+  const std::vector<MemoryRequest> copy(requests.begin(), requests.end());
+
+  auto from_vector = make_default_hierarchy(CacheType::SetAssociative);
+  auto from_view   = make_default_hierarchy(CacheType::SetAssociative);
+  auto from_range  = make_default_hierarchy(CacheType::SetAssociative);
+
+  from_vector->touch(copy);
+  from_view->touch(requests.subspan(0, 8));
+  from_view->touch(requests.subspan(8));
+  from_range->touch(copy.cbegin(), copy.cend());
+
+  for (const auto& ch : { from_view.get(), from_range.get() }) {
+    REQUIRE(ch->current_cycle() == from_vector->current_cycle());
+    REQUIRE(ch->getBundleOps().size() == from_vector->getBundleOps().size());
+    for (int level = 1; level <= DEFAULT_HIERARCHY_SIZE; level++) {
+      REQUIRE(ch->getHits(level) == from_vector->getHits(level));
+      REQUIRE(ch->getMisses(level) == from_vector->getMisses(level));
+    }
+  }
+}
+
+TEST_CASE("Compacted runs simulate the same as the requests in them", "[hierarchy]") {
+  const auto type = GENERATE(CacheType::SetAssociative, CacheType::DirectMapped,
+                             CacheType::Infinite);
+
+  // Bursts of accesses around a few random lines, some of them crossing into the next
+  // line, with the occasional bundle mixed in
+  std::vector<MemoryRequest> requests;
+  const auto lines = get_random_unique_addresses(8);
+  for (int i = 0; i < 2000; i++) {
+    const uint64_t line = lines[get_random_address() % lines.size()] & ~0x3fULL;
+    const int burst     = 1 + get_random_address() % 6;
+    for (int j = 0; j < burst; j++) {
+      const int offset = get_random_address() % DEFAULT_LINE_SIZE;
+      const int size   = 1 << (get_random_address() % 4);
+      const int bundle = i % 7 == 0 ? (j == 0 ? 1 : j == burst - 1 ? 3 : 2) : 0;
+      requests.emplace_back(0, size, bundle, false, line + offset, 0x400000 + i % 3);
+    }
+  }
+
+  std::vector<RequestRun> runs;
+  MemoryTraceTools::compact_runs(requests.begin(), requests.end(), DEFAULT_LINE_SIZE,
+                                 runs);
+  REQUIRE(runs.size() < requests.size());
+
+  auto expected  = make_default_hierarchy(type);
+  auto compacted = make_default_hierarchy(type);
+  expected->touch(requests);
+  compacted->touch(runs);
+
+  REQUIRE(compacted->current_cycle() == expected->current_cycle());
+  for (int level = 1; level <= DEFAULT_HIERARCHY_SIZE; level++) {
+    REQUIRE(compacted->getHits(level) == expected->getHits(level));
+    REQUIRE(compacted->getMisses(level) == expected->getMisses(level));
+    REQUIRE(compacted->getEvictions(level) == expected->getEvictions(level));
+    if (type != CacheType::Infinite)
+      REQUIRE(*compacted->getLifetimes(level) == *expected->getLifetimes(level));
+  }
+  for (int level = 0; level <= DEFAULT_HIERARCHY_SIZE; level++)
+    REQUIRE(compacted->getTraffic(level) == expected->getTraffic(level));
+
+  const auto& bundles = compacted->getBundleOps();
+  REQUIRE(bundles.size() == expected->getBundleOps().size());
+  for (const auto& [pc, stats] : expected->getBundleOps()) {
+    REQUIRE(bundles.at(pc).times_encountered == stats.times_encountered);
+    REQUIRE(bundles.at(pc).total_ops == stats.total_ops);
+  }
+}
+
 TEST_CASE("Hierarchy clock counts cycles correctly", "[hierarchy]") {
   auto ch = make_default_hierarchy(CacheType::SetAssociative);
   REQUIRE(ch->current_cycle() == 0);
@@ -27,6 +27,22 @@ TEST_CASE("Addresses are split correctly", "[model][common][addresses]") {
   REQUIRE(cache_address.tag == tag);
 }
 
+TEST_CASE("Line numbers are split like the addresses in them",
+          "[model][common][addresses]") {
+  std::unique_ptr<Cache> cache = make_default_cache(GENERATE(values(CACHE_TYPES)));
+
+  // The address is split independently of the cache's own masks and shifts
+  const uint64_t address = GENERATE(take(RANDOM_COUNT, random_addresses()));
+  const CacheAddress expected { address, cache->getSize(), cache->getLineSize(),
+                                cache->getSetSize() };
+  const auto split = cache->split_line(cache->line_of(address), cache->block_of(address));
+  REQUIRE(split.tag == expected.tag);
+  REQUIRE(split.index == expected.index);
+  REQUIRE(split.block == expected.block);
+  REQUIRE(cache->line_of(address) == address / DEFAULT_LINE_SIZE);
+  REQUIRE(cache->block_of(address) == address % DEFAULT_LINE_SIZE);
+}
+
 TEST_CASE("Cache type is returned correctly", "[model][common]") {
   const CacheType requested_type = GENERATE(values(CACHE_TYPES));
   std::unique_ptr<Cache> cache   = make_default_cache(requested_type);
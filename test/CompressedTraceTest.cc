@@ -0,0 +1,177 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "utils.hh"
+
+#include "CompressedTrace.hh"
+#include "TraceReader.hh"
+
+TEST_CASE("Compressed traces are equal to originals", "[trace][compressed]") {
+  const uint32_t block_size = GENERATE(1, 3, 16, DEFAULT_COMPRESSED_BLOCK_SIZE);
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+
+  const std::string fname { "testout.bin" };
+  trace.write_compressed(fname, block_size);
+
+  REQUIRE(MemoryTraceTools::guess_file_type(fname) == TraceFileType::Compressed);
+
+  SECTION("Sequential trace reads") {
+    const MemoryTrace compressed { std::ifstream { fname }, TraceFileType::Compressed };
+    REQUIRE(trace_equals(trace, compressed));
+  }
+  SECTION("Parallel trace reads") {
+    const MemoryTrace compressed { fname, TraceFileType::Compressed, 4 };
+    REQUIRE(trace_equals(trace, compressed));
+  }
+  SECTION("Streamed trace reads") {
+    CompressedTraceReader reader { fname };
+    std::vector<MemoryRequest> requests(5);
+
+    size_t i { 0 };
+    while (const size_t n = reader.read(requests.data(), requests.size()))
+      for (size_t j = 0; j < n; j++, i++)
+        REQUIRE(requests[j].address == trace.getRequests()[i].address);
+    REQUIRE(i == trace.getLength());
+  }
+}
+
+TEST_CASE("Compressed trace blocks can be decoded independently", "[trace][compressed]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+
+  const std::string fname { "testout.bin" };
+  trace.write_compressed(fname, 3);
+
+  const MappedCompressedTrace compressed { fname };
+  const auto& decoder = compressed.getDecoder();
+  REQUIRE(decoder.size() == trace.getLength());
+  REQUIRE(decoder.nblocks() == 6);
+
+  // Seek straight to a record in the middle of the trace
+  const uint64_t record { 10 };
+  const auto block = decoder.find_block(record);
+  REQUIRE(decoder.block_first(block) <= record);
+
+  std::vector<MemoryRequest> requests(decoder.block_size());
+  const size_t n = decoder.decode_block(block, requests.data());
+  REQUIRE(n == decoder.block_records(block));
+
+  const auto& request = requests[record - decoder.block_first(block)];
+  REQUIRE(request.address == trace.getRequests()[record].address);
+  REQUIRE(request.pc == trace.getRequests()[record].pc);
+}
+
+TEST_CASE("Traces compressed in memory decode to the original requests",
+          "[trace][compressed]") {
+  const uint32_t block_size = GENERATE(1, 3, 16, DEFAULT_COMPRESSED_BLOCK_SIZE);
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+
+  const CompressedTraceBuffer compressed { trace.getRequests(), block_size };
+  const auto& decoder = compressed.getDecoder();
+  REQUIRE(compressed.size() == trace.getLength());
+
+  // Matches the file written for the same trace byte for byte
+  trace.write_compressed("testout.bin", block_size);
+  REQUIRE(std::ifstream("testout.bin", std::ios::ate).tellg() ==
+          static_cast<std::streamoff>(compressed.bytes()));
+
+  std::vector<MemoryRequest> requests(decoder.block_size());
+  size_t i { 0 };
+  for (uint64_t b = 0; b < decoder.nblocks(); b++) {
+    const size_t n = decoder.decode_block(b, requests.data());
+    for (size_t j = 0; j < n; j++, i++) {
+      const auto original = trace.getRequest(i);
+      REQUIRE(requests[j].address == original.address);
+      REQUIRE(requests[j].pc == original.pc);
+      REQUIRE(requests[j].tid == original.tid);
+      REQUIRE(requests[j].size == original.size);
+      REQUIRE(requests[j].bundle_kind == original.bundle_kind);
+      REQUIRE(requests[j].is_write == original.is_write);
+    }
+  }
+  REQUIRE(i == trace.getLength());
+
+  const MemoryTrace empty { std::istringstream {} };
+  REQUIRE(CompressedTraceBuffer { empty.getRequests() }.getDecoder().nblocks() == 0);
+}
+
+TEST_CASE("Compressed traces are smaller than raw binary traces", "[trace][compressed]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+
+  trace.write_binary("testout.bin");
+  trace.write_compressed("testout.bin.z");
+
+  const auto raw_size = std::ifstream("testout.bin", std::ios::ate).tellg();
+  const auto compressed_size = std::ifstream("testout.bin.z", std::ios::ate).tellg();
+  REQUIRE(compressed_size < raw_size);
+}
+
+TEST_CASE("Corrupt compressed traces are rejected", "[trace][compressed]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::SIMPLE5 } };
+  const std::string fname { "testout.bin" };
+  trace.write_compressed(fname);
+
+  // Chop off the index
+  std::string data;
+  {
+    std::ifstream f { fname, std::ios::binary };
+    data.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  }
+  std::ofstream { fname, std::ios::binary }.write(data.data(), data.size() - 8);
+
+  REQUIRE_THROWS_AS(MappedCompressedTrace { fname }, std::invalid_argument);
+}
+
+/* Lay out a compressed trace from a header and the raw bytes of its blocks */
+static std::string make_compressed(const CompressedTrace::Header& fields,
+                                   const std::vector<std::string>& blocks) {
+  CompressedTrace::Header header = fields;
+  std::memcpy(header.magic, CompressedTrace::MAGIC, sizeof(CompressedTrace::MAGIC));
+  header.version = CompressedTrace::VERSION;
+
+  std::string body;
+  std::vector<uint64_t> offsets { sizeof(CompressedTrace::Header) };
+  for (const auto& block : blocks) {
+    body += block;
+    offsets.push_back(offsets.back() + block.size());
+  }
+  header.index_offset = offsets.back();
+
+  std::string data(reinterpret_cast<const char*>(&header), sizeof(header));
+  data += body;
+  data.append(reinterpret_cast<const char*>(offsets.data()),
+              offsets.size() * sizeof(uint64_t));
+  return data;
+}
+
+TEST_CASE("Compressed trace records are range-checked before they are narrowed",
+          "[trace][compressed]") {
+  // A tid of 70000, which would wrap to a valid one once narrowed, then a size of 8 and
+  // zero address and PC deltas
+  const std::string block { "\x00\xf0\xa2\x04\x08\x00\x00", 7 };
+  const auto data = make_compressed({ {}, 0, 1, 1, 1, 0 }, { block });
+
+  const CompressedTrace::Decoder decoder { data.data(), data.size() };
+  MemoryRequest request;
+  REQUIRE_THROWS_AS(decoder.decode_block(0, &request), std::out_of_range);
+}
+
+TEST_CASE("Compressed trace headers with impossible counts are rejected",
+          "[trace][compressed]") {
+  // One record of tid 0, size 8, at address and PC 0
+  const std::string block { "\x00\x00\x08\x00\x00", 5 };
+  const auto valid = make_compressed({ {}, 0, 1, 1, 1, 0 }, { block });
+  REQUIRE(CompressedTrace::Decoder { valid.data(), valid.size() }.size() == 1);
+
+  // So many blocks that the size of their index overflows, and more blocks than the
+  // records need
+  const std::string data = GENERATE_COPY(
+      make_compressed({ {}, 0, 1, 1, (uint64_t { 1 } << 61) - 1, 0 }, { block }),
+      make_compressed({ {}, 0, 1, 1, 2, 0 }, { block, block }));
+
+  REQUIRE_THROWS_AS((CompressedTrace::Decoder { data.data(), data.size() }),
+                    std::invalid_argument);
+}
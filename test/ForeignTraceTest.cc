@@ -0,0 +1,145 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "utils.hh"
+
+#include "ForeignTrace.hh"
+#include "TraceReader.hh"
+
+namespace {
+const std::string LACKEY = "==4242== Lackey, an example Valgrind tool\n"
+                           "==4242== Command: ./a.out\n"
+                           "==4242==\n"
+                           "I  04000850,3\n"
+                           " S 7ff000398,8\n"
+                           "I  04000853,4\n"
+                           " L 04010d98,8\n"
+                           " M 0421c7f0,4\n"
+                           "I  04000857,2\n"
+                           "I  0400085a,5\n"
+                           " L 04010da0,16\n"
+                           "==4242== Counted 1 call to main()\n";
+
+/* Append a drcachesim record */
+void add_record(std::string& trace, uint16_t type, uint16_t size, uint64_t address) {
+  char record[DrCacheSimTrace::RECORD_SIZE];
+  std::memcpy(record, &type, sizeof(type));
+  std::memcpy(record + 2, &size, sizeof(size));
+  std::memcpy(record + 4, &address, sizeof(address));
+  trace.append(record, sizeof(record));
+}
+
+/* Two threads, with instructions, loads, a store, a prefetch, and some bookkeeping */
+std::string make_drcachesim_trace() {
+  using namespace DrCacheSimTrace;
+  std::string trace;
+  add_record(trace, TYPE_HEADER, 0, 3);
+  add_record(trace, TYPE_THREAD, 4, 1234);
+  add_record(trace, TYPE_PID, 4, 1234);
+  add_record(trace, TYPE_MARKER, 2, 0xabc);
+  add_record(trace, TYPE_INSTR, 4, 0x400000);
+  add_record(trace, TYPE_READ, 8, 0x1000);
+  add_record(trace, TYPE_WRITE, 4, 0x2000);
+  add_record(trace, TYPE_THREAD, 4, 99);
+  add_record(trace, TYPE_INSTR_RETURN, 1, 0x400100);
+  add_record(trace, TYPE_PREFETCH, 64, 0x3000);
+  add_record(trace, TYPE_THREAD, 4, 1234);
+  add_record(trace, TYPE_READ, 2, 0x4000);
+  return trace;
+}
+
+void require_request(const MemoryRequest& request, int tid, int size, bool is_write,
+                     uint64_t address, uint64_t pc) {
+  REQUIRE(request.tid == tid);
+  REQUIRE(request.size == size);
+  REQUIRE(request.bundle_kind == 0);
+  REQUIRE(request.is_write == is_write);
+  REQUIRE(request.address == address);
+  REQUIRE(request.pc == pc);
+}
+}  // namespace
+
+TEST_CASE("Lackey traces give the PC of each data access", "[trace][foreign]") {
+  const MemoryTrace trace { std::istringstream { LACKEY }, TraceFileType::Lackey };
+  const auto requests = trace.getRequests();
+
+  // Modifies are a load followed by a store
+  REQUIRE(requests.size() == 5);
+  require_request(requests[0], 0, 8, true, 0x7ff000398, 0x4000850);
+  require_request(requests[1], 0, 8, false, 0x4010d98, 0x4000853);
+  require_request(requests[2], 0, 4, false, 0x421c7f0, 0x4000853);
+  require_request(requests[3], 0, 4, true, 0x421c7f0, 0x4000853);
+  require_request(requests[4], 0, 16, false, 0x4010da0, 0x400085a);
+}
+
+TEST_CASE("Lackey modifies are split across reads", "[trace][foreign]") {
+  std::istringstream ss { LACKEY };
+  LackeyTrace::Reader reader { ss };
+
+  std::vector<MemoryRequest> requests;
+  MemoryRequest request;
+  while (reader.read(&request, 1) == 1) requests.push_back(request);
+
+  REQUIRE(requests.size() == 5);
+  REQUIRE_FALSE(requests[2].is_write);
+  REQUIRE(requests[3].is_write);
+  REQUIRE(requests[3].address == requests[2].address);
+}
+
+TEST_CASE("Malformed Lackey lines are rejected", "[trace][foreign]") {
+  const auto line = GENERATE(as<std::string> {}, " L 1000\n", " X 1000,8\n", "I  zz,4\n",
+                             "1, 0, 0, 0, 8, 0x1000, 0x400000\n");
+  REQUIRE_THROWS_AS(MemoryTrace(std::istringstream { line }, TraceFileType::Lackey),
+                    std::invalid_argument);
+}
+
+TEST_CASE("drcachesim traces are decoded record by record", "[trace][foreign]") {
+  const auto data = make_drcachesim_trace();
+  const MemoryTrace trace { std::istringstream { data }, TraceFileType::DrCacheSim };
+  const auto requests = trace.getRequests();
+
+  // Threads are numbered as they appear, and prefetches are loads
+  REQUIRE(requests.size() == 4);
+  require_request(requests[0], 0, 8, false, 0x1000, 0x400000);
+  require_request(requests[1], 0, 4, true, 0x2000, 0x400000);
+  require_request(requests[2], 1, 64, false, 0x3000, 0x400100);
+  require_request(requests[3], 0, 2, false, 0x4000, 0x400100);
+}
+
+TEST_CASE("Imported traces are guessed, loaded, and streamed from files",
+          "[trace][foreign]") {
+  const std::string fname { "testout.bin" };
+  const auto [data, ftype] =
+      GENERATE(std::make_pair(LACKEY, TraceFileType::Lackey),
+               std::make_pair(make_drcachesim_trace(), TraceFileType::DrCacheSim));
+  std::ofstream(fname, std::ios::binary) << data;
+
+  REQUIRE(MemoryTraceTools::guess_file_type(fname) == ftype);
+  const MemoryTrace whole { std::istringstream { data }, ftype };
+  const auto expected = whole.getRequests();
+
+  // Loading a window of the trace from its file
+  const MemoryTrace window { fname, ftype, 1, 1, 2 };
+  REQUIRE(window.getLength() == 2);
+  for (size_t i = 0; i < window.getLength(); i++) {
+    REQUIRE(window.getRequests()[i].address == expected[i + 1].address);
+    REQUIRE(window.getRequests()[i].pc == expected[i + 1].pc);
+  }
+
+  // Streaming it a request at a time
+  auto reader = TraceReader::open(fname, ftype);
+  MemoryRequest request;
+  size_t n { 0 };
+  for (; reader->read(&request, 1) == 1; n++) {
+    REQUIRE(request.address == expected[n].address);
+    REQUIRE(request.is_write == expected[n].is_write);
+  }
+  REQUIRE(n == expected.size());
+
+  std::remove(fname.c_str());
+}
@@ -12,3 +12,15 @@ TEST_CASE("Infinite caches never evict", "[model][infinite][stats]"){
 
   REQUIRE(cache->getEvictions() == 0);
 }
+
+TEST_CASE("Infinite caches tell apart lines far from each other", "[model][infinite]") {
+  auto cache = make_default_cache(CacheType::Infinite);
+
+  // Lines whose numbers only differ above the low 32 bits
+  const uint64_t address = DEFAULT_LINE_SIZE;
+  cache->touch(address);
+  cache->touch(address + (uint64_t { 1 } << 40));
+
+  REQUIRE(cache->getMisses() == 2);
+  REQUIRE(cache->getHits() == 0);
+}
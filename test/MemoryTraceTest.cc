@@ -1,11 +1,15 @@
 #include "catch.hpp"
 
+#include <cstddef>
+#include <cstring>
 #include <fstream>
 #include <set>
 #include <sstream>
 
 #include "utils.hh"
 
+#include "BinaryTrace.hh"
+#include "HyperLogLog.hh"
 #include "MemoryTrace.hh"
 
 TEST_CASE("Trace files are loaded correctly", "[trace]") {
@@ -48,6 +52,43 @@ TEST_CASE("Memory requests are constructed correctly from trace entries", "[trac
   REQUIRE(req.pc == pc);
 }
 
+TEST_CASE("Traces store each distinct PC once", "[trace]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+
+  REQUIRE(trace.getLength() == 16);
+  REQUIRE(trace.getUniquePCs() == 4);
+  REQUIRE(trace.getRequests()[15].pc == 0x40e200);
+}
+
+TEST_CASE("Requests too wide for the packed representation are rejected", "[trace]") {
+  REQUIRE_THROWS_AS(MemoryTrace { std::istringstream {
+                        "1, 0, 0, 0, 4096, 0x6e0000, 0x40e370\n" } },
+                    std::out_of_range);
+}
+
+TEST_CASE("Request fields are range-checked before they are narrowed", "[trace]") {
+  // Each of these would wrap to a valid value once narrowed to its field
+  const std::string line = GENERATE("1, 70000, 0, 0, 8, 0x6e0000, 0x40e370\n",
+                                    "1, -1, 0, 0, 8, 0x6e0000, 0x40e370\n",
+                                    "1, 0, 0, 0, 69632, 0x6e0000, 0x40e370\n",
+                                    "1, 0, 0, 0, -8, 0x6e0000, 0x40e370\n",
+                                    "1, 0, 8, 0, 8, 0x6e0000, 0x40e370\n");
+  REQUIRE_THROWS_AS(MemoryTrace { std::istringstream { line } }, std::out_of_range);
+
+  MemoryRequest request;
+  REQUIRE_THROWS_AS(MemoryTraceTools::parse_text_line(line, request), std::out_of_range);
+}
+
+TEST_CASE("Binary trace records are range-checked before they are narrowed", "[trace]") {
+  std::vector<char> record(BinaryTrace::RECORD_SIZE, 0);
+  BinaryTrace::encode(make_mem_request(0x6e0000, 8), record.data());
+  REQUIRE(BinaryTrace::decode(record.data()).size == 8);
+
+  const int tid { 70000 };
+  std::memcpy(record.data(), &tid, sizeof(int));
+  REQUIRE_THROWS_AS(BinaryTrace::decode(record.data()), std::out_of_range);
+}
+
 TEST_CASE("Empty lines in trace files are skipped over", "[trace][regression]") {
   std::istringstream ss {
     "\n"
@@ -63,6 +104,82 @@ TEST_CASE("Empty lines in trace files are skipped over", "[trace][regression]")
   REQUIRE(addresses[1] == 0x4000863fb8f0);
 }
 
+TEST_CASE("Text trace fields may be separated by any blanks", "[trace]") {
+  std::istringstream ss {
+    "214864667,0,0,1,64,0x4000847ad870,0x434edc\r\n"
+    "  214864668\t0\t1\t0\t8\t4000863fb8f0\t434ef4  \r\n"
+    " \t\r\n"
+  };
+  const MemoryTrace trace { ss };
+
+  REQUIRE(trace.getLength() == 2);
+  REQUIRE(trace.getRequest(0).is_write);
+  REQUIRE(trace.getRequest(0).address == 0x4000847ad870);
+  REQUIRE(trace.getRequest(1).bundle_kind == 1);
+  REQUIRE(trace.getRequest(1).size == 8);
+  REQUIRE(trace.getRequest(1).pc == 0x434ef4);
+}
+
+TEST_CASE("Malformed text trace lines are rejected", "[trace]") {
+  const std::string line = GENERATE("1, 0, 0, 0, 64, 0x6e0000\n", "1, 0, 0, 0, 64, zz, 0x40\n");
+  REQUIRE_THROWS_AS(MemoryTrace { std::istringstream { line } }, std::invalid_argument);
+}
+
+TEST_CASE("Text traces are parsed in parallel correctly", "[trace]") {
+  // Large enough to be split between several threads
+  const std::string fname { "testout.log" };
+  {
+    std::ofstream f { fname };
+    for (int i = 0; i < 100000; i++) {
+      f << i << ", " << i % 4 << ", 0, " << i % 2 << ", 64, 0x" << std::hex << i * 64
+        << ", 0x" << 0x400000 + i % 100 << std::dec << "\n";
+      if (i % 1000 == 0) f << "\n";
+    }
+  }
+
+  const MemoryTrace serial { std::ifstream { fname } };
+  const MemoryTrace parallel { fname, TraceFileType::Text, 4 };
+
+  REQUIRE(serial.getLength() == 100000);
+  REQUIRE(trace_equals(serial, parallel));
+  REQUIRE(parallel.getUniquePCs() == 100);
+
+  // Summaries gathered by each thread add up to the summary of the whole trace
+  const auto summary = parallel.getSummary();
+  REQUIRE(summary.record_count == 100000);
+  REQUIRE(summary.unique_addresses == serial.getSummary().unique_addresses);
+  REQUIRE(summary.unique_lines_64 == serial.getSummary().unique_lines_64);
+  REQUIRE(summary.unique_lines_256 == serial.getSummary().unique_lines_256);
+  REQUIRE(summary.unique_lines_64 == Approx(100000).epsilon(0.03));
+  REQUIRE(summary.unique_lines_256 == Approx(25000).epsilon(0.03));
+}
+
+TEST_CASE("Distinct values are counted approximately in constant memory", "[trace]") {
+  HyperLogLog all, even, odd;
+  for (uint64_t repeat = 0; repeat < 3; repeat++) {
+    for (uint64_t value = 0; value < 200000; value++) {
+      all.add(value * 64);
+      (value % 2 == 0 ? even : odd).add(value * 64);
+    }
+  }
+
+  REQUIRE(all.estimate() == Approx(200000).epsilon(0.03));
+  REQUIRE(even.estimate() == Approx(100000).epsilon(0.03));
+
+  // Merging sketches gives exactly the sketch of the combined values
+  even.merge(odd);
+  REQUIRE(even.estimate() == all.estimate());
+
+  // Small counts are close to exact
+  HyperLogLog few;
+  for (uint64_t value = 0; value < 100; value++) few.add(value % 10);
+  REQUIRE(few.estimate() == 10);
+
+  REQUIRE(HyperLogLog {}.estimate() == 0);
+  REQUIRE_THROWS_AS(HyperLogLog { 2 }, std::invalid_argument);
+  REQUIRE_THROWS_AS(all.merge(HyperLogLog { 10 }), std::invalid_argument);
+}
+
 TEST_CASE("Writing and parsing binary trace files works", "[trace]") {
   std::istringstream ss {
     "4016124, 0, 0, 1, 64, 0x6e0000, 0x40e370\n"
@@ -81,4 +198,173 @@ TEST_CASE("Writing and parsing binary trace files works", "[trace]") {
     const MemoryTrace binary_trace { fname, TraceFileType::Binary };
     REQUIRE(trace_equals(trace, binary_trace));
   }
+  SECTION("Memory-mapped trace reads") {
+    const MappedBinaryTrace mapped_trace { fname };
+    REQUIRE(mapped_trace.size() == trace.getLength());
+
+    const auto requests = trace.getRequests();
+    size_t i { 0 };
+    for (const auto& request : mapped_trace) {
+      REQUIRE(request.address == requests[i].address);
+      REQUIRE(request.pc == requests[i].pc);
+      REQUIRE(request.is_write == requests[i].is_write);
+      i++;
+    }
+    REQUIRE(i == trace.getLength());
+  }
+}
+
+TEST_CASE("Binary trace headers carry a summary of the trace", "[trace]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+  const std::string fname { "testout.bin" };
+  trace.write_binary(fname);
+
+  REQUIRE(MemoryTraceTools::guess_file_type(fname) == TraceFileType::Binary);
+
+  const auto summary = BinaryTrace::read_summary(fname);
+  REQUIRE(summary);
+  REQUIRE(summary->record_count == 16);
+  REQUIRE(summary->bundle_count == 3);
+  REQUIRE(summary->min_address == 0x630a00);
+  REQUIRE(summary->max_address == 0x6e0000);
+
+  REQUIRE(summary->unique_addresses == 11);
+  REQUIRE(summary->unique_lines_64 == 7);
+  REQUIRE(summary->unique_lines_256 == 4);
+
+  const auto computed = trace.getSummary();
+  REQUIRE(summary->unique_addresses == computed.unique_addresses);
+  REQUIRE(summary->unique_lines_64 == computed.unique_lines_64);
+  REQUIRE(summary->unique_lines_256 == computed.unique_lines_256);
+  REQUIRE(computed.unique_lines_256 <= computed.unique_lines_64);
+
+  REQUIRE(MappedBinaryTrace { fname }.getSummary()->record_count == 16);
+}
+
+TEST_CASE("Binary traces without a header are still read", "[trace]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::SIMPLE5 } };
+  const std::string fname { "testout.bin" };
+  {
+    std::ofstream f { fname, std::ios::binary };
+    const size_t length { trace.getLength() };
+    f.write(reinterpret_cast<const char*>(&length), sizeof(size_t));
+
+    char record[BinaryTrace::RECORD_SIZE];
+    for (const auto& request : trace.getRequests()) {
+      BinaryTrace::encode(request, record);
+      f.write(record, BinaryTrace::RECORD_SIZE);
+    }
+  }
+
+  REQUIRE(!BinaryTrace::read_summary(fname));
+  REQUIRE(trace_equals(trace, MemoryTrace { fname, TraceFileType::Binary }));
+  REQUIRE(trace_equals(trace,
+                       MemoryTrace { std::ifstream { fname }, TraceFileType::Binary }));
+}
+
+TEST_CASE("Corrupt binary trace headers are rejected", "[trace]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::SIMPLE5 } };
+  const std::string fname { "testout.bin" };
+  trace.write_binary(fname);
+
+  {
+    std::fstream f { fname, std::ios::binary | std::ios::in | std::ios::out };
+    f.seekp(offsetof(BinaryTrace::Header, summary) +
+            offsetof(TraceSummary, unique_lines_64));
+    f.put(0x7f);
+  }
+
+  REQUIRE_THROWS_AS(BinaryTrace::read_summary(fname), std::invalid_argument);
+  REQUIRE_THROWS_AS(MappedBinaryTrace { fname }, std::invalid_argument);
+}
+
+TEST_CASE("Truncated binary trace files are rejected", "[trace]") {
+  const std::string fname { "testout.bin" };
+  {
+    std::ofstream f { fname, std::ios::binary };
+    const size_t length { 4 };
+    f.write(reinterpret_cast<const char*>(&length), sizeof(size_t));
+  }
+
+  REQUIRE_THROWS_AS(MappedBinaryTrace { fname }, std::invalid_argument);
+}
+
+TEST_CASE("Windows of traces are loaded without the rest of the trace", "[trace][window]") {
+  const std::string text_fname { "testout.log" };
+  {
+    std::ofstream f { text_fname };
+    for (int i = 0; i < 1000; i++) {
+      f << i << ", 0, 0, 0, 64, 0x" << std::hex << i * 64 << ", 0x" << 0x400000 + i % 7
+        << std::dec << "\n";
+      if (i % 100 == 0) f << "\n";
+    }
+  }
+  const MemoryTrace full { text_fname, TraceFileType::Text, 4 };
+  full.write_binary("testout.bin");
+  full.write_compressed("testout.bin.z", 64);
+
+  const auto [fname, ftype] = GENERATE(
+      std::make_pair(std::string { "testout.log" }, TraceFileType::Text),
+      std::make_pair(std::string { "testout.bin" }, TraceFileType::Binary),
+      std::make_pair(std::string { "testout.bin.z" }, TraceFileType::Compressed));
+  const auto [first, count] = GENERATE(table<size_t, size_t>(
+      { { 0, 1000 }, { 100, 250 }, { 130, 700 }, { 999, 5 }, { 1200, 5 } }));
+
+  const MemoryTrace window { fname, ftype, 4, first, count };
+
+  const size_t expected = first >= 1000 ? 0 : std::min(count, 1000 - first);
+  REQUIRE(window.getLength() == expected);
+  for (size_t i = 0; i < expected; i++) {
+    REQUIRE(window.getRequest(i).address == full.getRequest(first + i).address);
+    REQUIRE(window.getRequest(i).pc == full.getRequest(first + i).pc);
+  }
+}
+
+TEST_CASE("Filtered traces only hold the accepted requests", "[trace][filter]") {
+  const std::string text_fname { "testout.log" };
+  {
+    std::ofstream f { text_fname };
+    for (int i = 0; i < 1000; i++)
+      f << i << ", " << i % 4 << ", " << (i % 5 == 0 ? 1 : 0) << ", " << i % 3 % 2
+        << ", 8, 0x" << std::hex << i * 64 << ", 0x" << 0x400000 + i % 16 * 4 << std::dec
+        << "\n";
+  }
+  const MemoryTrace full { text_fname, TraceFileType::Text, 4 };
+  full.write_binary("testout.bin");
+  full.write_compressed("testout.bin.z", 64);
+
+  const auto [fname, ftype] = GENERATE(
+      std::make_pair(std::string { "testout.log" }, TraceFileType::Text),
+      std::make_pair(std::string { "testout.bin" }, TraceFileType::Binary),
+      std::make_pair(std::string { "testout.bin.z" }, TraceFileType::Compressed));
+  const bool parallel = GENERATE(true, false);
+
+  TraceFilter filter;
+  SECTION("By thread") { filter.tid = 2; }
+  SECTION("By access kind") { filter.is_write = true; }
+  SECTION("By PC range") {
+    filter.pc_min = 0x400008;
+    filter.pc_max = 0x400020;
+  }
+  SECTION("By address range") {
+    filter.address_min = 64 * 100;
+    filter.address_max = 64 * 199;
+  }
+  SECTION("By bundle kind") { filter.bundle_kinds = 0xfe; }
+  SECTION("Rejecting everything") { filter.tid = 7; }
+
+  std::vector<MemoryRequest> expected;
+  for (const auto& request : full.getRequests())
+    if (filter.accepts(request)) expected.push_back(request);
+
+  const MemoryTrace filtered =
+      parallel ? MemoryTrace { fname, ftype, 4, 0, SIZE_MAX, filter }
+               : MemoryTrace { std::ifstream { fname }, ftype, filter };
+
+  REQUIRE(filtered.getLength() == expected.size());
+  for (size_t i = 0; i < expected.size(); i++) {
+    REQUIRE(filtered.getRequest(i).address == expected[i].address);
+    REQUIRE(filtered.getRequest(i).pc == expected[i].pc);
+    REQUIRE(filtered.getRequest(i).tid == expected[i].tid);
+  }
 }
@@ -0,0 +1,170 @@
+#include "catch.hpp"
+
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+#include "utils.hh"
+
+#include "Sampling.hh"
+#include "TraceReader.hh"
+
+namespace {
+/* A trace of `n` requests that revisit a working set a few times larger than L1 */
+std::vector<MemoryRequest> make_sampling_trace(size_t n) {
+  const auto lines =
+      get_random_unique_addresses(4 * DEFAULT_CACHE_SIZE / DEFAULT_LINE_SIZE);
+
+  std::vector<MemoryRequest> requests;
+  for (size_t i = 0; i < n; i++)
+    requests.push_back(make_mem_request(lines[get_random_address() % lines.size()], 8));
+  return requests;
+}
+}  // namespace
+
+TEST_CASE("Periodic samples are taken from the end of each period", "[sampling]") {
+  SamplingConfig config { SamplingMode::Periodic, 10, 3 };
+
+  SECTION("Warming with every request between samples") {
+    SampleSchedule schedule { config };
+    for (int i = 0; i < 3; i++) {
+      const auto interval = schedule.next();
+      REQUIRE(interval.skip == 0);
+      REQUIRE(interval.warm == 7);
+      REQUIRE(interval.measure == 3);
+    }
+  }
+
+  SECTION("Warming with only some of them") {
+    config.warming = 2;
+    SampleSchedule schedule { config };
+    const auto interval = schedule.next();
+    REQUIRE(interval.skip == 5);
+    REQUIRE(interval.warm == 2);
+    REQUIRE(interval.measure == 3);
+  }
+}
+
+TEST_CASE("Random samples stay within their periods", "[sampling]") {
+  const uint64_t seed = GENERATE(take(DEFAULT_RANDOM_COUNT, random(0, 1000)));
+  const SamplingConfig config { SamplingMode::Random, 100, 10, 20, seed };
+  SampleSchedule schedule { config }, same_seed { config };
+
+  uint64_t end { 0 };
+  for (uint64_t period = 0; period < 50; period++) {
+    const auto interval = schedule.next();
+    const auto repeated = same_seed.next();
+    REQUIRE(interval.skip == repeated.skip);
+    REQUIRE(interval.warm == repeated.warm);
+
+    REQUIRE(interval.warm <= config.warming);
+    REQUIRE(interval.measure == config.sample_size);
+
+    end += interval.skip + interval.warm + interval.measure;
+    REQUIRE(end > period * config.period);
+    REQUIRE(end <= (period + 1) * config.period);
+  }
+}
+
+TEST_CASE("Invalid sampling configs are rejected", "[sampling]") {
+  REQUIRE_THROWS(SampleSchedule { SamplingConfig {} });
+  REQUIRE_THROWS(SampleSchedule { SamplingConfig { SamplingMode::Periodic, 10, 0 } });
+  REQUIRE_THROWS(SampleSchedule { SamplingConfig { SamplingMode::Periodic, 10, 11 } });
+}
+
+TEST_CASE("Sampled miss rates come with a confidence interval", "[sampling]") {
+  SampleStats stats;
+  stats.add({ 10 }, { 1 });
+  REQUIRE(stats.getMissRate(1).second == 1.0);
+
+  stats.add({ 10 }, { 2 });
+  stats.add({ 10 }, { 3 });
+  stats.add({ 0 }, { 0 });  // Never accessed, so left out
+
+  const auto [mean, error] = stats.getMissRate(1);
+  REQUIRE(stats.size() == 4);
+  REQUIRE(mean == Approx(0.2));
+  REQUIRE(error == Approx(4.303 * 0.1 / std::sqrt(3.0)));
+}
+
+TEST_CASE("Paused hierarchies update their caches without counting", "[sampling]") {
+  auto ch                = make_default_hierarchy(CacheType::SetAssociative);
+  const uint64_t address = get_random_address();
+
+  ch->touch(address + DEFAULT_CACHE_SIZE);
+  ch->pause_stats();
+  ch->touch(address);
+  ch->pause_stats();
+  ch->resume_stats();
+  ch->resume_stats();
+
+  REQUIRE(ch->getMisses(1) == 1);
+  REQUIRE(ch->getTraffic(0) == 1);
+
+  ch->touch(address);
+  REQUIRE(ch->getHits(1) == 1);
+  REQUIRE(ch->current_cycle() == 3);
+}
+
+TEST_CASE("Sampling every request simulates the whole trace", "[sampling]") {
+  const auto requests = make_sampling_trace(5000);
+  const size_t piece  = GENERATE(1, 7, 5000);
+
+  auto expected = make_default_hierarchy(CacheType::SetAssociative);
+  auto sampled  = make_default_hierarchy(CacheType::SetAssociative);
+  expected->touch(requests);
+
+  Sampler sampler { SamplingConfig { SamplingMode::Periodic, 100, 100 }, false };
+  const Span<const MemoryRequest> all { requests };
+  const auto touch = [](CacheHierarchy& cache, const auto& part) { cache.touch(part); };
+  for (size_t offset = 0; offset < all.size(); offset += piece)
+    sampler.run(*sampled, all.subspan(offset, piece), touch);
+  sampler.finish(*sampled);
+
+  REQUIRE(sampler.getMeasured() == requests.size());
+  REQUIRE(sampler.getStats().size() == 50);
+  for (int level = 1; level <= DEFAULT_HIERARCHY_SIZE; level++) {
+    REQUIRE(sampled->getHits(level) == expected->getHits(level));
+    REQUIRE(sampled->getMisses(level) == expected->getMisses(level));
+  }
+}
+
+TEST_CASE("Samples are only counted in the results", "[sampling]") {
+  const auto requests     = make_sampling_trace(10000);
+  const auto mode         = GENERATE(SamplingMode::Periodic, SamplingMode::Random);
+  const uint64_t warming  = GENERATE(0, 300, UINT64_MAX);
+  const SamplingConfig config { mode, 1000, 100, warming, 7 };
+
+  // Sampling from a trace in memory, or from a reader that drops skipped requests
+  auto from_memory = make_default_hierarchy(CacheType::SetAssociative);
+  auto from_reader = make_default_hierarchy(CacheType::SetAssociative);
+  const auto touch = [](CacheHierarchy& cache, const auto& part) { cache.touch(part); };
+
+  Sampler memory_sampler { config, false };
+  memory_sampler.run(*from_memory, Span<const MemoryRequest> { requests }, touch);
+  memory_sampler.finish(*from_memory);
+
+  std::ostringstream text;
+  for (size_t i = 0; i < requests.size(); i++)
+    text << i << ", 0, 0, 0, 8, 0x" << std::hex << requests[i].address << std::dec
+         << ", 0x400000\n";
+  std::istringstream ss { text.str() };
+  SampledTraceReader reader { std::make_unique<TextTraceReader>(ss), config };
+
+  Sampler reader_sampler { config, true };
+  std::vector<MemoryRequest> chunk(64);
+  while (const size_t n = reader.read(chunk.data(), chunk.size()))
+    reader_sampler.run(*from_reader, Span<const MemoryRequest> { chunk.data(), n },
+                       touch);
+  reader_sampler.finish(*from_reader);
+
+  for (const auto& sampler : { &memory_sampler, &reader_sampler }) {
+    REQUIRE(sampler->getMeasured() == 1000);
+    REQUIRE(sampler->getStats().size() == 10);
+  }
+  for (const auto& ch : { from_memory.get(), from_reader.get() })
+    REQUIRE(ch->getTraffic(0) == 1000 * 8);
+
+  REQUIRE(from_reader->getMisses(1) == from_memory->getMisses(1));
+  REQUIRE(from_reader->getMisses(2) == from_memory->getMisses(2));
+}
@@ -46,3 +46,40 @@ TEST_CASE("Conflicting memory addresses evict previous set-associative data",
   REQUIRE(cache->getMisses() == static_cast<uint64_t>(1) + associativity);
   REQUIRE(cache->getEvictions() == 1);
 }
+
+TEST_CASE("Set-associative caches evict the least recently used line",
+          "[model][set-associative]") {
+  auto config     = get_default_cache_config(CacheType::SetAssociative);
+  config.set_size = 4;
+  auto cache      = Cache::make_cache(config, std::make_shared<Clock>());
+
+  CacheAddress address { get_random_address(), *cache };
+  const auto with_tag = [&](uint64_t tag) {
+    address.tag = tag;
+    return address;
+  };
+
+  for (uint64_t tag = 1; tag <= 4; tag++) cache->touch(with_tag(tag));
+  cache->touch(with_tag(1));
+  cache->touch_repeated(with_tag(1), 10);
+  REQUIRE(cache->getHits() == 11);
+
+  // The first line filled was hit since, so the second one goes first
+  REQUIRE(cache->touch(with_tag(5)).evictions == 1);
+  REQUIRE(cache->touch(with_tag(1)).hits == 1);
+  REQUIRE(cache->touch(with_tag(2)).misses == 1);
+  REQUIRE(cache->touch(with_tag(3)).misses == 1);
+  REQUIRE(cache->touch(with_tag(1)).hits == 1);
+  REQUIRE(cache->touch(with_tag(5)).hits == 1);
+}
+
+TEST_CASE("Every tag can be cached, even in a single set of 1-byte lines",
+          "[model][set-associative]") {
+  const CacheConfig config { CacheType::SetAssociative, 4, 1, 4 };
+  auto cache = Cache::make_cache(config, std::make_shared<Clock>());
+
+  const CacheAddress address { UINT64_MAX, *cache };
+  REQUIRE(address.tag == UINT64_MAX);
+  REQUIRE(cache->touch(address).misses == 1);
+  REQUIRE(cache->touch(address).hits == 1);
+}
@@ -0,0 +1,115 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "utils.hh"
+
+#include "ShmRing.hh"
+#include "TraceReader.hh"
+
+namespace {
+/* Rings are shared between processes, so each test run gets names of its own */
+std::string make_ring_name(const std::string& suffix) {
+  return "shm:scs-test-" + std::to_string(getpid()) + "-" + suffix;
+}
+
+std::vector<MemoryRequest> make_ring_requests(size_t n) {
+  std::vector<MemoryRequest> requests;
+  for (size_t i = 0; i < n; i++) {
+    auto request = make_mem_request(get_random_address(), 8, i % 3 == 0);
+    request.pc   = i;
+    request.tid  = i % 4;
+    requests.push_back(request);
+  }
+  return requests;
+}
+
+/* Write `requests` to the ring in batches of random sizes, then close it. Runs on a
+ * thread of its own, so it reports failures through `ok` rather than asserting */
+void produce(const std::string& name, const std::vector<MemoryRequest>& requests,
+             bool& ok) {
+  ShmRing::Producer producer { name };
+  std::mt19937 rng { 42 };
+  std::uniform_int_distribution<size_t> batch_size { 1, 200 };
+  for (size_t offset = 0; offset < requests.size();) {
+    const size_t n = std::min(batch_size(rng), requests.size() - offset);
+    if (!producer.write(requests.data() + offset, n)) return;
+    offset += n;
+  }
+  ok = true;
+}
+
+bool same_request(const MemoryRequest& a, const MemoryRequest& b) {
+  return a.address == b.address && a.pc == b.pc && a.tid == b.tid && a.size == b.size &&
+         a.bundle_kind == b.bundle_kind && a.is_write == b.is_write;
+}
+}  // namespace
+
+TEST_CASE("Requests pass through a shared memory ring in order", "[shm]") {
+  const auto name     = make_ring_name("order");
+  const auto requests = make_ring_requests(100000);
+
+  // A ring much smaller than the batches read from it, so that both sides keep waiting
+  ShmRing::Consumer consumer { name, 64 };
+  REQUIRE(consumer.capacity() == 64);
+  bool ok { false };
+  std::thread producer { produce, name, std::cref(requests), std::ref(ok) };
+
+  std::vector<MemoryRequest> read, chunk(100);
+  while (const size_t n = consumer.read(chunk.data(), chunk.size())) {
+    REQUIRE(n <= chunk.size());
+    read.insert(read.end(), chunk.begin(), chunk.begin() + n);
+  }
+  producer.join();
+
+  REQUIRE(ok);
+  REQUIRE(read.size() == requests.size());
+  REQUIRE(std::equal(read.begin(), read.end(), requests.begin(), same_request));
+  REQUIRE(consumer.read(chunk.data(), chunk.size()) == 0);
+}
+
+TEST_CASE("Traces can be read from a shared memory ring", "[shm]") {
+  const auto name     = make_ring_name("reader");
+  const auto requests = make_ring_requests(5000);
+
+  auto reader = TraceReader::open(name, TraceFileType::Text);
+  bool ok { false };
+  std::thread producer { produce, name, std::cref(requests), std::ref(ok) };
+
+  std::vector<MemoryRequest> read, chunk(1000);
+  while (const size_t n = reader->read(chunk.data(), chunk.size()))
+    read.insert(read.end(), chunk.begin(), chunk.begin() + n);
+  producer.join();
+
+  REQUIRE(ok);
+  REQUIRE(std::equal(read.begin(), read.end(), requests.begin(), requests.end(),
+                     same_request));
+}
+
+TEST_CASE("Shared memory rings are owned by their consumer", "[shm]") {
+  const auto name = make_ring_name("owner");
+
+  REQUIRE_THROWS(ShmRing::Consumer(name, 100));
+  REQUIRE_THROWS(ShmRing::Consumer("shm:a/b"));
+
+  auto consumer = std::make_unique<ShmRing::Consumer>(name, 16);
+  REQUIRE_THROWS(ShmRing::Consumer(name, 16));
+
+  // Once the consumer is gone, the producer stops waiting for room
+  ShmRing::Producer producer { name, 0 };
+  const auto requests = make_ring_requests(32);
+  REQUIRE(producer.write(requests.data(), 16));
+  consumer.reset();
+  REQUIRE_FALSE(producer.write(requests.data(), requests.size()));
+
+  // And the ring can be created again
+  REQUIRE_NOTHROW(ShmRing::Consumer(name, 16));
+  REQUIRE_THROWS(ShmRing::Producer(name, 0));
+}
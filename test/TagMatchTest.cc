@@ -0,0 +1,38 @@
+#include "catch.hpp"
+
+#include <string>
+#include <vector>
+
+#include "utils.hh"
+
+#include "TagMatch.hh"
+
+TEST_CASE("Every tag matching kernel finds the same ways", "[model][tag-match]") {
+  const auto& kernels = TagMatch::available();
+  REQUIRE(std::string { kernels.back().name } == "portable");
+  REQUIRE(&TagMatch::best() == &kernels.front());
+
+  const int ways = GENERATE(1, 2, 3, 4, 7, 8, 9, 16, 31, 64);
+  std::vector<uint64_t> tags(ways);
+  for (int round = 0; round < DEFAULT_RANDOM_COUNT; round++) {
+    // Some ways are empty, and some share the tag looked up
+    const uint64_t tag = get_random_address() % 8;
+    for (auto& way : tags) {
+      way = get_random_address() % 10;
+      if (way == 9) way = TagMatch::EMPTY_TAG;
+    }
+
+    TagMatch::WayMasks expected { 0, 0 };
+    for (int way = 0; way < ways; way++) {
+      if (tags[way] == tag) expected.hits |= uint64_t { 1 } << way;
+      if (tags[way] != TagMatch::EMPTY_TAG) expected.valid |= uint64_t { 1 } << way;
+    }
+
+    for (const auto& implementation : kernels) {
+      INFO("Kernel: " << implementation.name << ", ways: " << ways);
+      const auto masks = implementation.kernel(tags.data(), ways, tag);
+      REQUIRE(masks.hits == expected.hits);
+      REQUIRE(masks.valid == expected.valid);
+    }
+  }
+}
@@ -1,7 +1,10 @@
 #include "catch.hpp"
 
+#include <cstdio>
 #include <fstream>
+#include <memory>
 #include <sstream>
+#include <vector>
 
 #include "utils.hh"
 
@@ -19,6 +22,20 @@ TEST_CASE("Converted traces are equal to originals", "[trace][converter-bin]") {
   REQUIRE(trace_equals(text_trace, bin_trace));
 }
 
+TEST_CASE("Compressed converted traces are equal to originals",
+          "[trace][converter-bin][compressed]") {
+  const auto text_fname = try_tracefile_names("traces/8.trace");
+
+  const std::string bin_fname { "8.bin" };
+  const auto status = TraceConverter::convert(text_fname, bin_fname, true, false,
+                                              TraceConverter::OutputFormat::Compressed);
+  REQUIRE(status == TraceConverter::ConvertStatus::Success);
+
+  const MemoryTrace text_trace { std::ifstream { text_fname } };
+  const MemoryTrace bin_trace { bin_fname, MemoryTraceTools::guess_file_type(bin_fname) };
+  REQUIRE(trace_equals(text_trace, bin_trace));
+}
+
 TEST_CASE("Converter does not overwrite output files without force", "[converter-bin]") {
   // Create a dummy file
   const std::string out_fname { "testout.bin" };
@@ -28,3 +45,140 @@ TEST_CASE("Converter does not overwrite output files without force", "[converter
   const auto status = TraceConverter::convert("test.in", out_fname, false, false);
   REQUIRE(status == TraceConverter::ConvertStatus::AlreadyExists);
 }
+
+TEST_CASE("Failed conversions leave no trace behind", "[converter-bin]") {
+  const auto format = GENERATE(TraceConverter::OutputFormat::Binary,
+                               TraceConverter::OutputFormat::Compressed);
+
+  const std::string in_fname { "testout.log" }, out_fname { "testout.bin" };
+  std::ofstream { in_fname } << "1, 0, 0, 0, 8, 0x6e0000, 0x40e370\nnot a request\n";
+  std::remove(out_fname.c_str());
+
+  auto status = TraceConverter::convert(in_fname, out_fname, false, false, format);
+  REQUIRE(status == TraceConverter::ConvertStatus::Error);
+  REQUIRE(!std::ifstream { out_fname }.is_open());
+  REQUIRE(!std::ifstream { out_fname + ".tmp" }.is_open());
+
+  // A forced conversion only replaces the output once it has succeeded
+  std::ofstream { out_fname } << "Test\n";
+  status = TraceConverter::convert(in_fname, out_fname, true, false, format);
+  REQUIRE(status == TraceConverter::ConvertStatus::Error);
+  std::string contents;
+  std::getline(std::ifstream { out_fname }, contents);
+  REQUIRE(contents == "Test");
+}
+
+TEST_CASE("Converting in several windows and threads preserves the trace",
+          "[trace][converter-bin]") {
+  const auto text_fname = try_tracefile_names("traces/8.trace");
+  const auto format = GENERATE(TraceConverter::OutputFormat::Binary,
+                               TraceConverter::OutputFormat::Compressed);
+
+  // A small window, so that the trace is split between many windows and threads
+  const std::string bin_fname { "8.bin" };
+  const auto status =
+      TraceConverter::convert(text_fname, bin_fname, true, false, format, 4, 1000);
+  REQUIRE(status == TraceConverter::ConvertStatus::Success);
+
+  const MemoryTrace text_trace { std::ifstream { text_fname } };
+  const MemoryTrace bin_trace { bin_fname, MemoryTraceTools::guess_file_type(bin_fname) };
+  REQUIRE(trace_equals(text_trace, bin_trace));
+}
+
+TEST_CASE("Several traces can be converted at once", "[converter-bin]") {
+  const std::vector<std::pair<std::string, std::string>> fnames {
+    { try_tracefile_names("traces/8.trace"), "8.bin" },
+    { "missing.log", "testout.bin" },
+  };
+
+  const auto statuses = TraceConverter::convert_all(fnames, true, false,
+                                                    TraceConverter::OutputFormat::Binary, 4);
+  REQUIRE(statuses.size() == 2);
+  REQUIRE(statuses[0] == TraceConverter::ConvertStatus::Success);
+  REQUIRE(statuses[1] == TraceConverter::ConvertStatus::Error);
+}
+
+TEST_CASE("Partitioned traces simulate like the whole trace", "[converter-bin]") {
+  const int bits          = GENERATE(0, 1, 3);
+  const auto format       = GENERATE(TraceConverter::OutputFormat::Binary,
+                                     TraceConverter::OutputFormat::Compressed);
+  const std::string fname = "testout.log";
+  {
+    // Mostly strided requests with some that cross a line, and a few bundles
+    std::ofstream f { fname };
+    for (int i = 0; i < 20000; i++) {
+      const uint64_t address = get_random_address() % (1 << 20) + (i % 7 == 0 ? 60 : 0);
+      f << i << ", 0, " << (i % 50 == 0 ? 1 : 0) << ", " << i % 2 << ", 8, 0x" << std::hex
+        << address << ", 0x" << 0x400000 + i % 10 << std::dec << "\n";
+    }
+  }
+
+  auto whole = make_default_hierarchy(CacheType::SetAssociative);
+  REQUIRE(can_partition(*whole, bits, DEFAULT_LINE_SIZE));
+  whole->touch(MemoryTrace { fname }.getRequests());
+
+  const auto status =
+      TraceConverter::partition(fname, "testout.bin", bits, DEFAULT_LINE_SIZE, true,
+                                false, format, 2, 1000);
+  REQUIRE(status == TraceConverter::ConvertStatus::Success);
+
+  std::vector<std::unique_ptr<CacheHierarchy>> parts;
+  for (int p = 0; p < (1 << bits); p++) {
+    const auto part_fname = TraceConverter::make_partition_name("testout.bin", p);
+    const MemoryTrace part { part_fname, MemoryTraceTools::guess_file_type(part_fname) };
+    for (const auto& request : part.getRequests())
+      REQUIRE((request.address / DEFAULT_LINE_SIZE) % (1 << bits) ==
+              static_cast<uint64_t>(p));
+
+    parts.push_back(make_default_hierarchy(CacheType::SetAssociative));
+    parts.back()->touch(part.getRequests());
+  }
+
+  for (int level = 1; level <= DEFAULT_HIERARCHY_SIZE; level++) {
+    uint64_t hits { 0 }, misses { 0 }, evictions { 0 };
+    for (const auto& part : parts) {
+      hits += part->getHits(level);
+      misses += part->getMisses(level);
+      evictions += part->getEvictions(level);
+    }
+    REQUIRE(hits == whole->getHits(level));
+    REQUIRE(misses == whole->getMisses(level));
+    REQUIRE(evictions == whole->getEvictions(level));
+  }
+
+  uint64_t requested { 0 }, bundles { 0 };
+  for (const auto& part : parts) {
+    requested += part->getTraffic(0);
+    for (const auto& [pc, stats] : part->getBundleOps()) bundles += stats.total_ops;
+  }
+  REQUIRE(requested == whole->getTraffic(0));
+  REQUIRE(bundles == 20000 / 50);
+}
+
+TEST_CASE("Failed partitions leave no traces behind", "[converter-bin]") {
+  const std::string in_fname { "testout.log" }, out_fname { "testout.bin" };
+  std::ofstream { in_fname } << "1, 0, 0, 0, 8, 0x6e0000, 0x40e370\nnot a request\n";
+
+  for (int p = 0; p < 4; p++)
+    std::remove(TraceConverter::make_partition_name(out_fname, p).c_str());
+
+  const auto status = TraceConverter::partition(in_fname, out_fname, 2, 64, true, false);
+  REQUIRE(status == TraceConverter::ConvertStatus::Error);
+  for (int p = 0; p < 4; p++) {
+    const auto partition_fname = TraceConverter::make_partition_name(out_fname, p);
+    REQUIRE(!std::ifstream { partition_fname }.is_open());
+    REQUIRE(!std::ifstream { partition_fname + ".tmp" }.is_open());
+  }
+}
+
+TEST_CASE("Only hierarchies with enough sets can be partitioned", "[converter-bin]") {
+  const auto hierarchy = make_default_hierarchy(CacheType::SetAssociative);
+  const int l1_sets    = DEFAULT_CACHE_SIZE / 2 / DEFAULT_LINE_SIZE / DEFAULT_SET_SIZE;
+
+  REQUIRE(can_partition(*hierarchy, nbits(l1_sets), DEFAULT_LINE_SIZE));
+  REQUIRE(!can_partition(*hierarchy, nbits(l1_sets) + 1, DEFAULT_LINE_SIZE));
+  REQUIRE(!can_partition(*hierarchy, 1, DEFAULT_LINE_SIZE * 2));
+
+  REQUIRE(TraceConverter::make_partition_name("out.bin", 3) == "out.3.bin");
+  REQUIRE(TraceConverter::make_partition_name("dir.d/out", 3) == "dir.d/out.3");
+}
@@ -0,0 +1,293 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "utils.hh"
+
+#include "TraceStream.hh"
+
+TEST_CASE("Text trace readers return requests in chunks", "[trace][stream]") {
+  std::istringstream ss { TestTraces::BUNDLE };
+  TextTraceReader reader { ss };
+
+  std::vector<MemoryRequest> chunk(5);
+  REQUIRE(reader.read(chunk.data(), chunk.size()) == 5);
+  REQUIRE(reader.read(chunk.data(), chunk.size()) == 5);
+  REQUIRE(reader.read(chunk.data(), chunk.size()) == 5);
+  REQUIRE(reader.read(chunk.data(), chunk.size()) == 1);
+  REQUIRE(chunk[0].address == 0x6cf660);
+  REQUIRE(reader.read(chunk.data(), chunk.size()) == 0);
+}
+
+TEST_CASE("Every stream consumer sees the whole trace in order", "[trace][stream]") {
+  const int nconsumers    = GENERATE(1, 3);
+  const size_t chunk_size = GENERATE(1, 3, 64);
+  const size_t nchunks    = GENERATE(1, 2);
+
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+
+  std::istringstream ss { TestTraces::BUNDLE };
+  TraceStream stream { std::make_unique<TextTraceReader>(ss), nconsumers, chunk_size,
+                       nchunks };
+
+  std::vector<std::vector<uint64_t>> seen(nconsumers);
+  std::vector<std::thread> consumers;
+  for (int i = 0; i < nconsumers; i++)
+    consumers.emplace_back([&, i]() {
+      while (const auto chunk = stream.next(i))
+        for (const auto& request : *chunk) seen[i].push_back(request.address);
+    });
+  for (auto& t : consumers) t.join();
+
+  const auto addresses = trace.getRequestAddresses();
+  const std::vector<uint64_t> expected(addresses.begin(), addresses.end());
+
+  REQUIRE(stream.getLength() == trace.getLength());
+  for (const auto& consumer_addresses : seen) REQUIRE(consumer_addresses == expected);
+}
+
+TEST_CASE("Streamed simulations match simulations of loaded traces", "[trace][stream]") {
+  auto loaded   = make_default_hierarchy(CacheType::SetAssociative);
+  auto streamed = make_default_hierarchy(CacheType::SetAssociative);
+
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+  loaded->touch(trace.getRequests());
+
+  std::istringstream ss { TestTraces::BUNDLE };
+  TraceStream stream { std::make_unique<TextTraceReader>(ss), 1, 4, 2 };
+  while (const auto chunk = stream.next(0)) streamed->touch(*chunk);
+
+  REQUIRE(streamed->current_cycle() == loaded->current_cycle());
+  for (int level = 1; level <= DEFAULT_HIERARCHY_SIZE; level++) {
+    REQUIRE(streamed->getHits(level) == loaded->getHits(level));
+    REQUIRE(streamed->getMisses(level) == loaded->getMisses(level));
+  }
+}
+
+TEST_CASE("Binary traces can be streamed from a pipe", "[trace][stream]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+  trace.write_binary("testout.bin");
+
+  const std::string fifo_fname { "testout.fifo" };
+  unlink(fifo_fname.c_str());
+  REQUIRE(mkfifo(fifo_fname.c_str(), 0600) == 0);
+  REQUIRE(MemoryTraceTools::is_live_input(fifo_fname));
+  REQUIRE(MemoryTraceTools::is_live_input("-"));
+  REQUIRE(!MemoryTraceTools::is_live_input("testout.bin"));
+
+  // Opening a pipe blocks until both ends are open, so feed it from another thread
+  std::thread writer { [&]() {
+    std::ifstream in { "testout.bin", std::ios::binary };
+    std::ofstream out { fifo_fname, std::ios::binary };
+    out << in.rdbuf();
+  } };
+
+  const auto reader = TraceReader::open(fifo_fname, TraceFileType::Binary);
+  std::vector<MemoryRequest> requests(64);
+  size_t n { 0 };
+  while (const size_t read = reader->read(requests.data() + n, requests.size() - n))
+    n += read;
+  writer.join();
+  unlink(fifo_fname.c_str());
+
+  REQUIRE(n == trace.getLength());
+  for (size_t i = 0; i < n; i++) {
+    REQUIRE(requests[i].address == trace.getRequest(i).address);
+    REQUIRE(requests[i].pc == trace.getRequest(i).pc);
+  }
+}
+
+TEST_CASE("Trace readers can read a window of a trace", "[trace][stream][window]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+  trace.write_binary("testout.bin");
+  trace.write_compressed("testout.bin.z", 3);
+  {
+    std::ofstream f { "testout.log" };
+    f << TestTraces::BUNDLE;
+  }
+
+  const auto [fname, ftype] = GENERATE(
+      std::make_pair(std::string { "testout.log" }, TraceFileType::Text),
+      std::make_pair(std::string { "testout.bin" }, TraceFileType::Binary),
+      std::make_pair(std::string { "testout.bin.z" }, TraceFileType::Compressed));
+  const auto [first, count] =
+      GENERATE(table<size_t, size_t>({ { 0, 16 }, { 4, 5 }, { 7, 100 }, { 20, 1 } }));
+
+  const auto reader = TraceReader::open(fname, ftype, first, count);
+  std::vector<MemoryRequest> requests(2);
+  std::vector<uint64_t> seen;
+  while (const size_t n = reader->read(requests.data(), requests.size()))
+    for (size_t i = 0; i < n; i++) seen.push_back(requests[i].address);
+
+  const size_t expected = first >= 16 ? 0 : std::min(count, 16 - first);
+  REQUIRE(seen.size() == expected);
+  for (size_t i = 0; i < expected; i++)
+    REQUIRE(seen[i] == trace.getRequest(first + i).address);
+}
+
+TEST_CASE("Filtered trace readers skip rejected requests", "[trace][stream][filter]") {
+  const MemoryTrace trace { std::istringstream { TestTraces::BUNDLE } };
+  trace.write_binary("testout.bin");
+
+  TraceFilter filter;
+  filter.bundle_kinds = 0x01;  // Only the two requests that are not part of a bundle
+
+  const auto reader = TraceReader::open("testout.bin", TraceFileType::Binary, 0, SIZE_MAX,
+                                        filter);
+  std::vector<MemoryRequest> requests(3);
+  std::vector<uint64_t> seen;
+  while (const size_t n = reader->read(requests.data(), requests.size()))
+    for (size_t i = 0; i < n; i++) seen.push_back(requests[i].address);
+
+  REQUIRE(seen == std::vector<uint64_t> { 0x6e0000, 0x630a00 });
+}
+
+TEST_CASE("Warm-up readers count the warm-up requests a filter accepts",
+          "[trace][stream][filter][warmup]") {
+  // Reads and writes alternate, so a filter keeps every other request
+  std::ostringstream trace;
+  for (int i = 0; i < 40; i++)
+    trace << i << ", 0, 0, " << i % 2 << ", 8, 0x" << std::hex << 0x1000 + 64 * i
+          << std::dec << ", 0x400030\n";
+  {
+    std::ofstream f { "testout.log" };
+    f << trace.str();
+  }
+
+  TraceFilter filter;
+  filter.is_write = true;
+
+  const auto [first, warmup, count, expected_warmup, expected_window] =
+      GENERATE(table<size_t, uint64_t, size_t, uint64_t, size_t>(
+          { { 10, 10, 10, 5, 5 }, { 10, 5, 10, 2, 5 }, { 30, 20, 100, 5, 0 } }));
+
+  std::atomic<uint64_t> warmup_length { 0 };
+  WarmupTraceReader reader { TraceReader::open("testout.log", TraceFileType::Text, first,
+                                               warmup + count),
+                             warmup, filter, warmup_length };
+  REQUIRE(warmup_length == WarmupTraceReader::UNKNOWN_LENGTH);
+
+  // A read never returns requests from both sides of the warm-up, and the length is
+  // known before any request after it is returned
+  std::vector<MemoryRequest> requests(4);
+  std::vector<uint64_t> seen;
+  while (const size_t n = reader.read(requests.data(), requests.size())) {
+    const uint64_t before = seen.size();
+    for (size_t i = 0; i < n; i++) seen.push_back(requests[i].address);
+    REQUIRE((warmup_length <= before || warmup_length >= before + n));
+    if (before + n > expected_warmup) REQUIRE(warmup_length == expected_warmup);
+  }
+
+  REQUIRE(warmup_length == expected_warmup);
+  REQUIRE(seen.size() == expected_warmup + expected_window);
+  for (size_t i = 0; i < seen.size(); i++)
+    REQUIRE(seen[i] == 0x1000 + 64 * (first + 2 * i + 1));
+}
+
+TEST_CASE("Per-thread traces are merged by sequence number", "[trace][stream][merge]") {
+  std::istringstream thread0 { "1, 0, 0, 0, 8, 0x1000, 0x400000\n"
+                               "4, 0, 0, 0, 8, 0x1004, 0x400000\n"
+                               "\n"
+                               "5, 0, 0, 1, 8, 0x1005, 0x400000\n" };
+  std::istringstream thread1 { "2, 1, 0, 0, 8, 0x2002, 0x400004\n"
+                               "5, 1, 0, 0, 8, 0x2005, 0x400004\n"
+                               "9, 1, 0, 0, 8, 0x2009, 0x400004\n" };
+  std::istringstream thread2 { "3, 2, 0, 0, 8, 0x3003, 0x400008\n" };
+
+  std::vector<std::unique_ptr<TextTraceReader>> readers;
+  for (auto* ss : { &thread0, &thread1, &thread2 })
+    readers.push_back(std::make_unique<TextTraceReader>(*ss));
+  MergedTraceReader reader { std::move(readers) };
+
+  const size_t chunk_size = GENERATE(1, 2, 16);
+  std::vector<MemoryRequest> requests(chunk_size);
+  std::vector<uint64_t> seen;
+  while (const size_t n = reader.read(requests.data(), requests.size()))
+    for (size_t i = 0; i < n; i++) seen.push_back(requests[i].address);
+
+  // Ties are broken by the order of the traces
+  REQUIRE(seen == std::vector<uint64_t> { 0x1000, 0x2002, 0x3003, 0x1004, 0x1005, 0x2005,
+                                          0x2009 });
+}
+
+TEST_CASE("Only text traces can be merged", "[trace][stream][merge]") {
+  const std::vector<std::string> fnames { "a.bin", "b.bin" };
+  REQUIRE_THROWS_WITH(TraceReader::open(fnames, TraceFileType::Binary),
+                      "Only text traces can be merged by sequence number");
+}
+
+TEST_CASE("Mapped text trace readers read and skip like stream readers",
+          "[trace][stream]") {
+  {
+    std::ofstream f { "testout.log" };
+    f << TestTraces::BUNDLE << "\n\n";
+  }
+  const size_t first = GENERATE(0, 3, 16, 20);
+  const size_t chunk = GENERATE(1, 5, 64);
+
+  std::istringstream ss { TestTraces::BUNDLE };
+  TextTraceReader expected { ss };
+  MappedTextTraceReader reader { "testout.log" };
+  reader.set_readahead(2);
+  REQUIRE(reader.skip(first) == expected.skip(first));
+
+  std::vector<MemoryRequest> got(chunk), want(chunk);
+  size_t n;
+  do {
+    n = reader.read(got.data(), chunk);
+    REQUIRE(n == expected.read(want.data(), chunk));
+    for (size_t i = 0; i < n; i++) REQUIRE(got[i].address == want[i].address);
+  } while (n > 0);
+}
+
+/* Takes `delay` to read each chunk, like a reader of a slow filesystem */
+class SlowTraceReader : public TraceReader {
+  std::unique_ptr<TraceReader> reader;
+  const std::chrono::milliseconds delay;
+
+ public:
+  SlowTraceReader(std::unique_ptr<TraceReader> reader, std::chrono::milliseconds delay)
+      : reader(std::move(reader)), delay(delay) { }
+
+  virtual size_t read(MemoryRequest* out, size_t max) override {
+    std::this_thread::sleep_for(delay);
+    return reader->read(out, max);
+  }
+};
+
+TEST_CASE("Trace streams account for time spent waiting on reads", "[trace][stream]") {
+  // The 16 requests take 4 reads of 4, and one more to find the end
+  constexpr std::chrono::milliseconds delay { 20 };
+  constexpr double delay_s = delay.count() / 1000.0;
+
+  const auto start = std::chrono::steady_clock::now();
+  std::istringstream ss { TestTraces::BUNDLE };
+  TraceStream stream { std::make_unique<SlowTraceReader>(
+                           std::make_unique<TextTraceReader>(ss), delay),
+                       2, 4, 2 };
+
+  std::vector<std::thread> consumers;
+  for (int consumer = 0; consumer < 2; consumer++)
+    consumers.emplace_back([&, consumer]() {
+      while (stream.next(consumer)) { }
+    });
+  for (auto& t : consumers) t.join();
+  const double elapsed =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // The consumers do no work, so they wait for most of every read
+  REQUIRE(stream.getReadTime() >= 5 * delay_s);
+  REQUIRE(stream.getReadTime() <= elapsed);
+  for (int consumer = 0; consumer < 2; consumer++) {
+    REQUIRE(stream.getStallTime(consumer) >= 3 * delay_s);
+    REQUIRE(stream.getStallTime(consumer) <= elapsed);
+  }
+}
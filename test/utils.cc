@@ -78,6 +78,20 @@ std::unique_ptr<CacheHierarchy> make_default_hierarchy(CacheType type) {
   return std::make_unique<CacheHierarchy>(configs);
 }
 
+bool can_partition(const CacheHierarchy& hierarchy, int bits, int line_size) {
+  for (int level = 1; level <= hierarchy.nlevels(); level++) {
+    if (hierarchy.getLineSize(level) != line_size) return false;
+    if (hierarchy.getType(level) == CacheType::Infinite) continue;
+
+    // Sets are picked by the low bits of the line index, so there must be at least one
+    // set per partition
+    const uint64_t sets = static_cast<uint64_t>(hierarchy.getSize(level)) /
+                          hierarchy.getLineSize(level) / hierarchy.getSetSize(level);
+    if (sets < (uint64_t { 1 } << bits)) return false;
+  }
+  return true;
+}
+
 bool trace_equals(const MemoryTrace& trace1, const MemoryTrace& trace2) {
   if (trace1.getLength() != trace2.getLength()) return false;
 
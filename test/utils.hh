@@ -54,6 +54,12 @@ std::unique_ptr<Cache> make_default_cache(CacheType type);
  * parameters */
 std::unique_ptr<CacheHierarchy> make_default_hierarchy(CacheType type);
 
+/* Whether a trace split by the low `bits` bits of its `line_size` byte line indices
+ * (see `TraceConverter::partition`) can be simulated one partition at a time on
+ * `hierarchy`, with the same hits, misses, evictions, and traffic once the results are
+ * added up */
+bool can_partition(const CacheHierarchy& hierarchy, int bits, int line_size);
+
 /* Check whether two memory traces represent the same sequence of memory requests */
 bool trace_equals(const MemoryTrace& trace1, const MemoryTrace& trace2);
 